@@ -0,0 +1,341 @@
+#include "Game.hpp"
+#include "PlatformHeadless.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+// Deterministic frame benchmark. Loads the same scene as Game::Init and waits for all of it, replays a scripted
+// camera + rotation path and writes frame time statistics as JSON.
+//
+// Usage: Benchmark [--frames N] [--warmup N] [--mode rasterized|raytraced|packets|both|all] [--threads N] [--kernel auto|scalar|avx2|avx512] [--filter nearest|mip|bilinear|trilinear] [--trace-tile N] [--loader-threads N] [--textures bc|rgba8] [--texture-budget KB] [--out FILE] [--verify]
+// The JSON goes to a file (benchmark.json by default) so log output can't corrupt it.
+// --verify renders the rasterized path with every kernel and filter instead and exits with 1
+// when a SIMD kernel gives a different frame than the scalar one.
+
+struct BenchmarkResult
+{
+	std::string mode;
+	std::vector<double> frameTimesMs;
+	uint64_t triangles = 0;
+	uint64_t rays = 0;
+	uint64_t verticesProjected = 0;
+	uint64_t trianglesClipped = 0;
+	uint64_t modelsCulled = 0;
+	uint64_t trianglesOccluded = 0;
+	uint64_t blocksOccluded = 0;
+	std::vector<uint64_t> raysPerThread;
+	uint64_t tlasUpdates[3] = {}; // Indexed by TLASUpdate
+	uint64_t heapAllocations = 0;
+	uint64_t maxHeapAllocations = 0; // Of a single frame
+	TextureCacheModel::Counts textureCache; // Of the measured frames, with MEASURE_TEXTURE_CACHE
+	uint64_t textureLoads = 0, textureEvictions = 0; // With a texture budget
+	size_t maxResidentTextureBytes = 0;
+};
+
+// From the start of Init
+struct LoadTimes
+{
+	double firstFrameMs = 0.0; // Until the first frame was rendered, with whatever had loaded by then
+	double allAssetsMs = 0.0; // Until every model was in the scene
+};
+
+class BenchmarkGame : public Game
+{
+public:
+	BenchmarkGame(Platform* platform) : Game("Benchmark", platform) {}
+
+	// Replaces Game::Update, everything is driven by the frame index instead of wall clock
+	void Update() override {}
+
+	void SetFrame(int frame, int frameCount)
+	{
+		float t = float(frame) / float(frameCount);
+
+		// Strafe left/right while dollying in, the model keeps spinning
+		mainCam.eye = { 3.f * sinf(t * 2.f * 3.14159f), 0.5f * sinf(t * 4.f * 3.14159f), -5.f + 2.f * t };
+		rotationIncrement = frame * 0.01f;
+
+		lights[0]->position = float3(0.f, 10.f, -5.f);
+	}
+
+	BenchmarkResult Run(const char* mode, int frames, int warmup)
+	{
+		BenchmarkResult result;
+		result.mode = mode;
+		result.frameTimesMs.reserve(frames);
+
+		gameState.rasterized = strcmp(mode, "rasterized") == 0;
+		gameState.packets = strcmp(mode, "packets") == 0;
+		gameState.raytraced = strcmp(mode, "raytraced") == 0 || gameState.packets;
+
+		for (int i = 0; i < warmup; i++)
+		{
+			SetFrame(0, frames);
+			Render();
+		}
+
+		TextureCacheModel::Reset();
+		for (int i = 0; i < frames; i++)
+		{
+			SetFrame(i, frames);
+
+			auto start = std::chrono::steady_clock::now();
+			Render();
+			auto end = std::chrono::steady_clock::now();
+
+			result.frameTimesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			result.triangles += GetStats().trianglesRasterized;
+			result.rays += GetStats().raysTraced;
+			result.verticesProjected += GetStats().verticesProjected;
+			result.trianglesClipped += GetStats().trianglesClipped;
+			result.modelsCulled += GetStats().modelsCulled;
+			result.trianglesOccluded += GetStats().occlusion.trianglesOccluded;
+			result.blocksOccluded += GetStats().occlusion.blocksOccluded;
+			result.heapAllocations += GetStats().heapAllocations;
+			result.maxHeapAllocations = std::max(result.maxHeapAllocations, GetStats().heapAllocations);
+			if (gameState.raytraced) result.tlasUpdates[static_cast<int>(GetStats().tlasUpdate)]++;
+			result.textureLoads += GetStats().textureStreaming.loadsCompleted;
+			result.textureEvictions += GetStats().textureStreaming.levelsEvicted;
+			result.maxResidentTextureBytes = std::max(result.maxResidentTextureBytes, GetStats().textureStreaming.residentBytes);
+
+			const std::vector<uint64_t>& threadRays = GetStats().raysPerThread;
+			result.raysPerThread.resize(std::max(result.raysPerThread.size(), threadRays.size()));
+			for (size_t t = 0; t < threadRays.size(); t++) result.raysPerThread[t] += threadRays[t];
+		}
+		result.textureCache = TextureCacheModel::GetCounts();
+
+		return result;
+	}
+
+	// Every frame of the path with every filter, rendered by the scalar kernel and then by
+	// each SIMD kernel the CPU has. False when any of them differs from the scalar frame
+	bool Verify(int frames)
+	{
+		const TextureFilter filters[] = { TextureFilter::Nearest, TextureFilter::NearestMip, TextureFilter::Bilinear, TextureFilter::Trilinear };
+		const RasterKernel kernels[] = { RasterKernel::AVX2, RasterKernel::AVX512 };
+
+		// Auto picks the widest kernel the CPU has, the ones before it run as well
+		rasterizer->SetKernel(RasterKernel::Auto);
+		const RasterKernel widest = rasterizer->GetKernel();
+
+		gameState.rasterized = true;
+		gameState.raytraced = false;
+		gameState.packets = false;
+
+		const size_t pixelCount = size_t(SCREEN_WIDTH) * SCREEN_HEIGHT;
+		std::vector<uint32_t> reference(pixelCount);
+		bool same = true;
+
+		for (int i = 0; i < frames; i++)
+		{
+			SetFrame(i, frames);
+			for (TextureFilter filter : filters)
+			{
+				rasterizer->SetTextureFilter(filter);
+				rasterizer->SetKernel(RasterKernel::Scalar);
+				Render();
+				std::copy(framebuffer, framebuffer + pixelCount, reference.begin());
+
+				for (RasterKernel kernel : kernels)
+				{
+					if (kernel > widest) continue;
+
+					rasterizer->SetKernel(kernel);
+					Render();
+					size_t differing = 0;
+					for (size_t p = 0; p < pixelCount; p++) differing += framebuffer[p] != reference[p];
+					if (differing == 0) continue;
+
+					Logger::Error("Frame " + std::to_string(i) + ", " + Rasterizer::GetKernelName(kernel) + " with " + Rasterizer::GetTextureFilterName(filter) +
+						" filtering: " + std::to_string(differing) + " pixels differ from the scalar kernel");
+					same = false;
+				}
+			}
+		}
+		return same;
+	}
+
+	const std::vector<Model*>& GetModels() const { return models; }
+};
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+	size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// s as a quoted JSON string. Paths on Windows are full of backslashes
+static std::string JSONString(const std::string& s)
+{
+	std::string quoted = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\') quoted += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			quoted += escaped;
+		}
+		else quoted += c;
+	}
+	return quoted + "\"";
+}
+
+static void WriteJSON(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::vector<Model*>& models, const LoadTimes& loadTimes, uint32_t loaderThreads,
+	int frames, int warmup, uint32_t threads, RasterKernel kernel, TextureFilter filter, bool compressTextures, size_t textureBudget, int traceTileSize)
+{
+	out << std::fixed << std::setprecision(3);
+	out << "{\n";
+	out << "  \"resolution\": [" << SCREEN_WIDTH << ", " << SCREEN_HEIGHT << "],\n";
+	out << "  \"frames\": " << frames << ",\n";
+	out << "  \"warmup\": " << warmup << ",\n";
+	out << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "  \"renderThreads\": " << threads << ",\n";
+	out << "  \"rasterKernel\": " << JSONString(Rasterizer::GetKernelName(kernel)) << ",\n";
+	out << "  \"traceTileSize\": " << traceTileSize << ",\n";
+	out << "  \"textureFilter\": " << JSONString(Rasterizer::GetTextureFilterName(filter)) << ",\n";
+	out << "  \"textureCompression\": " << (compressTextures ? "true" : "false") << ",\n";
+	out << "  \"textureBudget\": " << textureBudget << ",\n";
+	out << "  \"loading\": { \"loaderThreads\": " << loaderThreads << ", \"firstFrameMs\": " << loadTimes.firstFrameMs << ", \"allAssetsMs\": " << loadTimes.allAssetsMs << " },\n";
+	out << "  \"meshes\": [\n";
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		const Mesh& mesh = models[i]->mesh;
+		size_t textureBytes = 0;
+		for (const Texture& texture : mesh.textures) textureBytes += texture.GetMemorySize();
+
+		out << "    { \"path\": " << JSONString(models[i]->filePath) << ", \"vertices\": " << mesh.positions.size() << ", \"triangles\": " << mesh.triangle.size();
+		out << ", \"textureBytes\": " << textureBytes << ", \"textureArrayBytes\": " << mesh.textureArray.size() * sizeof(uint64_t);
+		out << ", \"materialRanges\": " << mesh.materialRanges.size();
+		out << ", \"acmr\": { \"source\": " << mesh.sourceACMR << ", \"optimized\": " << mesh.optimizedACMR << " } }" << (i + 1 < models.size() ? "," : "") << "\n";
+	}
+	out << "  ],\n";
+	out << "  \"modes\": [\n";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& r = results[i];
+
+		std::vector<double> sorted = r.frameTimesMs;
+		std::sort(sorted.begin(), sorted.end());
+
+		double totalMs = 0.0;
+		for (double t : sorted) totalMs += t;
+		double totalSeconds = totalMs / 1000.0;
+
+		out << "    {\n";
+		out << "      \"mode\": " << JSONString(r.mode) << ",\n";
+		out << "      \"frameTimeMs\": { ";
+		out << "\"min\": " << (sorted.empty() ? 0.0 : sorted.front()) << ", ";
+		out << "\"median\": " << Percentile(sorted, 0.5) << ", ";
+		out << "\"p95\": " << Percentile(sorted, 0.95) << ", ";
+		out << "\"p99\": " << Percentile(sorted, 0.99) << ", ";
+		out << "\"mean\": " << (sorted.empty() ? 0.0 : totalMs / sorted.size()) << " },\n";
+		out << "      \"trianglesPerSecond\": " << (totalSeconds > 0 ? r.triangles / totalSeconds : 0.0) << ",\n";
+		out << "      \"raysPerSecond\": " << (totalSeconds > 0 ? r.rays / totalSeconds : 0.0) << ",\n";
+		out << "      \"verticesProjectedPerFrame\": " << double(r.verticesProjected) / std::max<size_t>(1, sorted.size()) << ",\n";
+		out << "      \"clippedTrianglesPerFrame\": " << double(r.trianglesClipped) / std::max<size_t>(1, sorted.size()) << ",\n";
+		out << "      \"culledModelsPerFrame\": " << double(r.modelsCulled) / std::max<size_t>(1, sorted.size()) << ",\n";
+		out << "      \"occludedTrianglesPerFrame\": " << double(r.trianglesOccluded) / std::max<size_t>(1, sorted.size()) << ",\n";
+		out << "      \"occludedBlocksPerFrame\": " << double(r.blocksOccluded) / std::max<size_t>(1, sorted.size()) << ",\n";
+		out << "      \"tlasUpdates\": { \"skipped\": " << r.tlasUpdates[0] << ", \"refit\": " << r.tlasUpdates[1] << ", \"rebuild\": " << r.tlasUpdates[2] << " },\n";
+		out << "      \"heapAllocations\": { \"total\": " << r.heapAllocations << ", \"maxPerFrame\": " << r.maxHeapAllocations << " },\n";
+		if (textureBudget > 0)
+			out << "      \"textureStreaming\": { \"loads\": " << r.textureLoads << ", \"evictions\": " << r.textureEvictions << ", \"maxResidentBytes\": " << r.maxResidentTextureBytes << " },\n";
+#ifdef MEASURE_TEXTURE_CACHE
+		double pixels = double(std::max<uint64_t>(1, r.textureCache.pixels));
+		out << "      \"textureCache\": { \"readsPerPixel\": " << r.textureCache.reads / pixels << ", \"missesPerPixel\": " << r.textureCache.misses / pixels << " },\n";
+#endif
+		out << "      \"raysPerThread\": [";
+		for (size_t t = 0; t < r.raysPerThread.size(); t++) out << (t ? ", " : "") << r.raysPerThread[t];
+		out << "]\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = 240;
+	int warmup = 10;
+	std::string mode = "both";
+	std::string outPath = "benchmark.json";
+	uint32_t threadCount = 0;
+	RasterKernel rasterKernel = RasterKernel::Auto;
+	TextureFilter textureFilter = TextureFilter::NearestMip;
+	int traceTileSize = 16;
+	uint32_t loaderThreadCount = 0;
+	bool compressTextures = true;
+	size_t textureBudget = 0;
+	bool verify = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = std::max(1, std::atoi(argv[++i]));
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) warmup = std::max(0, std::atoi(argv[++i]));
+		else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) mode = argv[++i];
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) rasterKernel = Rasterizer::ParseKernelName(argv[++i]);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) textureFilter = Rasterizer::ParseTextureFilterName(argv[++i]);
+		else if (strcmp(argv[i], "--trace-tile") == 0 && i + 1 < argc) traceTileSize = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--loader-threads") == 0 && i + 1 < argc) loaderThreadCount = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--textures") == 0 && i + 1 < argc) compressTextures = strcmp(argv[++i], "rgba8") != 0;
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) textureBudget = size_t(std::max(0, std::atoi(argv[++i]))) * 1024;
+		else if (strcmp(argv[i], "--verify") == 0) verify = true;
+	}
+
+	BenchmarkGame* benchmark = new BenchmarkGame(new HeadlessPlatform());
+	benchmark->threadCount = threadCount;
+	benchmark->rasterKernel = rasterKernel;
+	benchmark->textureFilter = textureFilter;
+	benchmark->traceTileSize = traceTileSize;
+	benchmark->loaderThreadCount = loaderThreadCount;
+	benchmark->compressTextures = compressTextures;
+	benchmark->textureBudget = textureBudget;
+
+	// Init returns as soon as the window could show frames, the models come in behind it. The
+	// first frame is the one the game would show, in its default render mode
+	auto loadStart = std::chrono::steady_clock::now();
+	benchmark->Init();
+	benchmark->SetFrame(0, frames);
+	benchmark->Render();
+	LoadTimes loadTimes;
+	loadTimes.firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+	benchmark->WaitForAssets();
+	loadTimes.allAssetsMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+	if (verify)
+	{
+		bool same = benchmark->Verify(frames);
+		if (same) Logger::Log("Every kernel rendered the same frames as the scalar one");
+		delete benchmark;
+		return same ? 0 : 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	if (mode == "rasterized" || mode == "both" || mode == "all") results.push_back(benchmark->Run("rasterized", frames, warmup));
+	if (mode == "raytraced" || mode == "both" || mode == "all") results.push_back(benchmark->Run("raytraced", frames, warmup));
+	if (mode == "packets" || mode == "all") results.push_back(benchmark->Run("packets", frames, warmup));
+
+	std::ofstream file(outPath);
+	if (file)
+	{
+		WriteJSON(file, results, benchmark->GetModels(), loadTimes, benchmark->GetLoaderThreadCount(), frames, warmup, benchmark->GetThreadCount(), benchmark->GetRasterKernel(), benchmark->GetTextureFilter(), benchmark->compressTextures, benchmark->textureBudget, benchmark->traceTileSize);
+		Logger::Log("Benchmark results written to " + outPath);
+	}
+	else
+	{
+		Logger::Error("Cannot open " + outPath);
+	}
+
+	delete benchmark;
+
+	return 0;
+}
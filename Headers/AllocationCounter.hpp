@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+
+// Heap allocations made through operator new, which covers every standard container.
+// Counted when COUNT_ALLOCATIONS is defined (Benchmark project and Debug builds), otherwise always 0
+namespace AllocationCounter
+{
+	uint64_t GetCount();
+}
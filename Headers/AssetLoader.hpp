@@ -0,0 +1,85 @@
+#pragma once
+#include "Model.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A model the AssetLoader is working on. Copies share the same load, Get() stays nullptr
+// until every stage of it is done. A load that failed or was dropped with the loader turns
+// ready too, without a model: Get() and Wait() give nullptr and GetError() says why
+class ModelHandle
+{
+public:
+	ModelHandle() = default;
+
+	bool IsValid() const { return future.valid(); }
+	bool IsReady() const { return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	bool IsFailed() const { return IsReady() && !Get(); }
+
+	Model* Get() const { return IsReady() ? Wait() : nullptr; }
+	Model* Wait() const; // Blocks until the model is ready or the load failed
+	std::string GetError() const; // Empty unless the load failed
+
+private:
+	friend class AssetLoader;
+	std::shared_future<Model*> future;
+};
+
+// Loads models on its own threads, next to the render JobSystem, so frames keep coming
+// while assets load. A model is split into tasks: LoadGeometry first, once that is done
+// one task per texture decode and one for the BVHs, which any loader thread can pick up. Several models and the textures of one model load in parallel.
+class AssetLoader
+{
+public:
+	// threadCount 0 = one thread per hardware thread. packTextures moves the textures of a
+	// model into its texture array (Mesh::PackTextures) once they are all loaded
+	AssetLoader(uint32_t threadCount = 0, bool compressTextures = false, bool packTextures = false);
+	~AssetLoader(); // Waits for the tasks that are running, models that weren't done fail
+
+	ModelHandle LoadModel(const std::string& filePath);
+
+	// Runs task on a loader thread, after the ones queued before it
+	void Enqueue(std::function<void()> task);
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	struct ModelLoad
+	{
+		~ModelLoad(); // Fails the handle if the load never finished, its tasks were dropped
+
+		Model* model = nullptr;
+		std::promise<Model*> promise;
+		bool delivered = false;
+		std::atomic<uint32_t> tasksLeft{ 0 };
+		std::chrono::steady_clock::time_point start;
+
+		std::mutex errorMutex;
+		std::exception_ptr error; // First exception one of its tasks threw
+	};
+
+	void WorkerLoop();
+
+	void LoadGeometry(const std::shared_ptr<ModelLoad>& load);
+	void RunTask(ModelLoad& load, const std::function<void()>& task); // Keeps the exception task throws for the handle
+	void FinishTask(ModelLoad& load);
+
+	bool compressTextures;
+	bool packTextures;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::function<void()>> tasks;
+	bool quit = false;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "tinyBVH.hpp"
+#include <cstdint>
+#include <string>
+#include <span>
+
+// BuildHQ results saved next to the asset, as "<asset>.<key>.bvh". The key hashes the
+// vertices, the indices and the build settings, so an edited asset or a different tinybvh simply
+// misses instead of loading a stale tree.
+namespace BVHCache
+{
+	// Fills bvh with the SBVH BVH8_CPU::BuildHQ starts from (4 triangles per leaf), loaded
+	// from the cache when possible. On a miss it is built and written back atomically:
+	// the file is saved under a unique temporary name and renamed into place, so other
+	// processes only ever see no file or a complete one. Returns true on a cache hit.
+	// The tree is indexed, vertices and indices (3 per triangle) have to outlive it.
+	bool LoadOrBuildHQ(const std::string& assetPath, std::span<const tinybvh::bvhvec4> vertices, std::span<const uint32_t> indices, tinybvh::BVH& bvh);
+
+	uint64_t Key(std::span<const tinybvh::bvhvec4> vertices, std::span<const uint32_t> indices);
+	std::string PathFor(const std::string& assetPath, uint64_t key);
+}
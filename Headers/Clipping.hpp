@@ -0,0 +1,68 @@
+#pragma once
+#include "Math.hpp"
+
+// Outcode bits of a clip space position, one per plane it is outside of. The frustum is
+// -w <= x, y <= w and 0 <= z <= w (mat::Perspective maps near to 0 and far to w). The guard
+// band planes are GUARD_BAND times as far out in x and y, inside them the rasterizer's
+// screen clamp is all the clipping a triangle needs.
+constexpr uint32_t CLIP_LEFT = 1 << 0;
+constexpr uint32_t CLIP_RIGHT = 1 << 1;
+constexpr uint32_t CLIP_BOTTOM = 1 << 2;
+constexpr uint32_t CLIP_TOP = 1 << 3;
+constexpr uint32_t CLIP_NEAR = 1 << 4;
+constexpr uint32_t CLIP_FAR = 1 << 5;
+constexpr uint32_t CLIP_GUARD_LEFT = 1 << 6;
+constexpr uint32_t CLIP_GUARD_RIGHT = 1 << 7;
+constexpr uint32_t CLIP_GUARD_BOTTOM = 1 << 8;
+constexpr uint32_t CLIP_GUARD_TOP = 1 << 9;
+
+// Outside one of these for all corners means nothing is visible
+constexpr uint32_t CLIP_FRUSTUM = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR;
+
+// Crossing one of these means the triangle has to be clipped. Near because the projection
+// breaks down behind the eye, the guard band because the rasterizer's fixed point has a range
+constexpr uint32_t CLIP_GEOMETRY = CLIP_NEAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP;
+
+// Clipping a triangle against the 5 planes of CLIP_GEOMETRY adds at most one vertex per plane
+constexpr int MAX_CLIPPED_VERTICES = 3 + 5;
+
+inline uint32_t ComputeClipCode(float x, float y, float z, float w)
+{
+	float guard = GUARD_BAND * w;
+	uint32_t code = 0;
+	if (x < -w) code |= CLIP_LEFT;
+	if (x > w) code |= CLIP_RIGHT;
+	if (y < -w) code |= CLIP_BOTTOM;
+	if (y > w) code |= CLIP_TOP;
+	if (z < 0.f) code |= CLIP_NEAR;
+	if (z > w) code |= CLIP_FAR;
+	if (x < -guard) code |= CLIP_GUARD_LEFT;
+	if (x > guard) code |= CLIP_GUARD_RIGHT;
+	if (y < -guard) code |= CLIP_GUARD_BOTTOM;
+	if (y > guard) code |= CLIP_GUARD_TOP;
+	return code;
+}
+
+// Polygon corner during clipping, uv is interpolated along with the clip space position
+struct ClipVertex
+{
+	float4 position;
+	float2 uv;
+};
+
+// Sutherland-Hodgman against the CLIP_GEOMETRY planes set in planes. out needs room for
+// MAX_CLIPPED_VERTICES, returns how many it got, less than 3 means nothing is left.
+// The winding of the input is kept
+int ClipTriangle(const ClipVertex in[3], uint32_t planes, ClipVertex out[MAX_CLIPPED_VERTICES]);
+
+// AND of the outcodes of the corners of an object space box, anything in CLIP_FRUSTUM
+// means the whole box is outside the view
+uint32_t ComputeBoxClipCode(const float3& boundsMin, const float3& boundsMax, const mat4& MV, const mat4& proj);
+
+// Front facing in the winding the meshes use, from the clip space x, y and w of the corners.
+// Works for corners behind the eye as well, so it can run before clipping
+inline bool FrontFacing(const float4& c0, const float4& c1, const float4& c2)
+{
+	float det = c0.x * (c1.y * c2.w - c1.w * c2.y) - c0.y * (c1.x * c2.w - c1.w * c2.x) + c0.w * (c1.x * c2.y - c1.y * c2.x);
+	return det < 0.f;
+}
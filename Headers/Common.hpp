@@ -1,6 +1,10 @@
 #pragma once
+#include <cstddef>
 // #define DEBUGMODE
 // #define FULLSCREEN
+// COUNT_ALLOCATIONS: global operator new counts heap allocations, see AllocationCounter.hpp. Set by
+// the Benchmark project and Debug builds of the game, not here, so Release builds keep the plain allocator
+// #define MEASURE_TEXTURE_CACHE // Texel reads of the scalar paths go through a simulated cache, see TextureCacheModel.hpp
 
 constexpr float EPSILON = 1e-3;
 
@@ -22,4 +26,13 @@ const float CAMERA_SHIFT_INCREMENT_HEIGHT = SCREEN_HEIGHT;
 
 constexpr int TRI_N = 12;
 
-constexpr float M_PI = 3.14159f;
\ No newline at end of file
+constexpr int TILE_SIZE = 64; // Rasterizer bins triangles into TILE_SIZE x TILE_SIZE screen tiles
+constexpr int HIZ_BLOCK_SIZE = 8; // Resolution of the rasterizer's coarse depth buffer, has to divide TILE_SIZE
+constexpr float GUARD_BAND = 8.f; // Triangles are only clipped in x and y beyond GUARD_BAND times the screen, in clip space
+constexpr size_t FRAME_ARENA_BYTES_PER_THREAD = 1 << 20; // Starting size, a region grows to the largest frame it sees
+constexpr int VERTEX_BATCH_SIZE = 4096; // Vertices per transform job of the geometry front end, a multiple of 8
+constexpr int GEOMETRY_BATCH_SIZE = 512; // Triangles per front end job, batches are binned in submission order
+
+#ifndef M_PI
+constexpr float M_PI = 3.14159f;
+#endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+// Instruction sets the CPU and OS both support, read once through CPUID / XGETBV
+struct CpuFeatures
+{
+	bool avx = false;
+	bool avx2 = false;
+	bool fma = false;
+	bool avx512f = false;
+	bool avx512bw = false;
+	bool avx512dq = false;
+};
+
+const CpuFeatures& GetCpuFeatures();
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator one thread fills during a frame. Running out chains another block, Reset()
+// then replaces the chain with one block of the combined size, so a region stops touching
+// the heap once it has seen its largest frame.
+class alignas(64) ScratchRegion
+{
+public:
+	ScratchRegion() = default;
+	~ScratchRegion();
+	ScratchRegion(const ScratchRegion&) = delete;
+	ScratchRegion& operator=(const ScratchRegion&) = delete;
+
+	void* Allocate(size_t bytes, size_t alignment);
+
+	// Uninitialized, nothing is destroyed, so only for trivial types
+	template<typename T>
+	std::span<T> AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "The arena never runs destructors");
+		return { static_cast<T*>(Allocate(count * sizeof(T), alignof(T) < 32 ? 32 : alignof(T))), count };
+	}
+
+	// Everything allocated since the last Reset() is gone
+	void Reset();
+
+	// Resets and makes sure a frame of bytes fits in one block
+	void Reserve(size_t bytes);
+
+	size_t GetCapacity() const;
+	size_t GetHighWater() const { return highWater; } // Most bytes one frame used
+
+private:
+	struct Block
+	{
+		uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	Block current;
+	size_t offset = 0;
+	size_t usedBefore = 0; // Bytes in the overflow blocks of this frame
+	std::vector<Block> overflow;
+	size_t highWater = 0;
+};
+
+// Per frame memory of the geometry pipeline, one scratch region per JobSystem thread.
+// Reset once at the start of a frame, every allocation of the previous frame is released.
+class FrameArena
+{
+public:
+	FrameArena(uint32_t threadCount, size_t initialBytesPerThread);
+
+	void Reset();
+
+	// Only thread (the JobSystem thread index) may allocate from its region
+	ScratchRegion& GetScratch(uint32_t thread) { return regions[thread]; }
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(regions.size()); }
+
+	size_t GetHighWater() const; // Summed over the threads
+
+private:
+	std::vector<ScratchRegion> regions;
+};
@@ -3,20 +3,40 @@
 #include "Program.hpp"
 #include "Ray.hpp"
 #include "Model.hpp"
+#include "AssetLoader.hpp"
+#include "TextureStreamer.hpp"
 #include "PointLight.h"
+#include "Rasterizer.hpp"
+#include "GeometryPipeline.hpp"
+#include "JobSystem.hpp"
+#include "SceneTracker.hpp"
+#include "FrameArena.hpp"
+#include "AllocationCounter.hpp"
 #include <algorithm>
 
-static uint32_t* framebuffer = nullptr;
-static BITMAPINFO bitmapInfo;
-
 struct RenderState
 {
 	bool raytraced = false;
 	bool rasterized = true;
 	bool hyrbid = false;
+	bool packets = false; // Ray traced primary rays go through the scene in 16x16 packets
 };
 
-static RenderState gameState;
+// Per-frame counters, reset at the start of every Render()
+struct RenderStats
+{
+	uint64_t trianglesSubmitted = 0;	// Triangles handed to RenderObject
+	uint64_t trianglesRasterized = 0;	// Handed to the rasterizer after culling and clipping
+	uint64_t trianglesClipped = 0;		// Crossed the near plane or the guard band
+	uint64_t modelsCulled = 0;			// Bounding box outside the view, skipped before the vertex work
+	uint64_t verticesProjected = 0;		// Mesh vertices plus clipped polygon corners RenderObject projected
+	uint64_t raysTraced = 0;			// Primary and shadow rays
+	std::vector<uint64_t> raysPerThread;	// raysTraced split by render thread
+	OcclusionStats occlusion;			// Rasterizer work skipped by the hierarchical depth test
+	TLASUpdate tlasUpdate = TLASUpdate::Skipped; // What bringing the TLAS up to date took, ray traced frames only
+	TextureStreamingStats textureStreaming; // Only with a texture budget
+	uint64_t heapAllocations = 0;		// operator new calls while rendering, 0 once the frame arena and containers are warm, the assets are loaded and streamed textures stay put
+};
 
 struct InputState 
 {
@@ -26,93 +46,11 @@ struct InputState
 	bool moveRight = false;
 };
 
-static InputState input;
-
-static inline LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
-{
-	switch (uMsg) {
-	case WM_DESTROY:
-		PostQuitMessage(0);
-		return 0;
-
-	case WM_PAINT: {
-		PAINTSTRUCT ps;
-		HDC hdc = BeginPaint(hwnd, &ps);
-
-		if (framebuffer) {
-			StretchDIBits(hdc, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
-				0, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
-				framebuffer, &bitmapInfo, DIB_RGB_COLORS, SRCCOPY);
-		}
-
-		EndPaint(hwnd, &ps);
-		return 0;
-	}
-
-	case WM_KEYDOWN:
-		switch (wParam)
-		{
-		case 'T':
-		{
-			if (gameState.rasterized == true)
-			{
-				gameState.rasterized = false;
-				gameState.raytraced = true;
-			}
-			else if (gameState.raytraced == true)
-			{
-				gameState.rasterized = true;
-				gameState.raytraced = false;
-			}
-			break;
-		}
-		case 'W': case VK_UP:
-			input.moveForward = true;
-			break;
-		case 'S': case VK_DOWN:
-			input.moveBackward = true;
-			break;
-		case 'A': case VK_LEFT:
-			input.moveLeft = true;
-			break;
-		case 'D': case VK_RIGHT:
-			input.moveRight = true;
-			break;
-		case VK_ESCAPE:
-			PostQuitMessage(0);
-			break;
-		
-		}
-		return 0;
-
-	case WM_KEYUP:
-		switch (wParam) 
-		{
-		case 'W': case VK_UP:
-			input.moveForward = false;
-			break;
-		case 'S': case VK_DOWN:
-			input.moveBackward = false;
-			break;
-		case 'A': case VK_LEFT:
-			input.moveLeft = false;
-			break;
-		case 'D': case VK_RIGHT:
-			input.moveRight = false;
-			break;
-		}
-		return 0;
-		
-	}
-
-    return DefWindowProc(hwnd, uMsg, wParam, lParam);
-};
-
 class Game : public Program
 {
 public:
-	Game(const char* title) : Program(title) {}
-	~Game() {}
+	Game(const char* title, Platform* platform) : Program(title, platform) {}
+	~Game() { delete assets; delete textureStreamer; }
 
 	void Init() override;
 	void Shutdown() override;
@@ -121,17 +59,48 @@ public:
 	void HandleInput() override;
 	void Update() override;
 
-	// Windowing:
-    HWND window;
-	HDC hdc;
-	bool createWindow(int widht, int height, const wchar_t* title);
-    void UpdateWindow();
+	void OnKeyDown(Key key) override;
+	void OnKeyUp(Key key) override;
+
+	// Finished frame, 0xAARRGGBB
+	const uint32_t* GetFramebuffer() const { return framebuffer; }
+
+	const RenderStats& GetStats() const { return stats; }
+	uint32_t GetThreadCount() const { return jobs ? jobs->GetThreadCount() : 1; }
+	uint32_t GetLoaderThreadCount() const { return assets ? assets->GetThreadCount() : 0; }
+	// Blocks until every queued model is in the scene or failed to load
+	void WaitForAssets();
+	bool AssetsLoaded() const { return pendingModels.empty(); }
+
+	RasterKernel GetRasterKernel() const { return rasterizer ? rasterizer->GetKernel() : RasterKernel::Scalar; }
+	TextureFilter GetTextureFilter() const { return rasterizer ? rasterizer->GetTextureFilter() : textureFilter; }
+
+	RenderState gameState;
+	InputState input;
+
+	uint32_t threadCount = 0; // Render threads, 0 = all hardware threads. Set before Init()
+	RasterKernel rasterKernel = RasterKernel::Auto; // Pixel kernel of the rasterizer. Set before Init()
+	TextureFilter textureFilter = TextureFilter::NearestMip; // Set before Init()
+	int traceTileSize = 16; // Ray traced frames are split into traceTileSize x traceTileSize tiles
+	uint32_t loaderThreadCount = 0; // Asset loader threads, 0 = all hardware threads. Set before Init()
+	bool compressTextures = true; // Textures are kept BC1 / BC3 compressed. Set before Init()
+	size_t textureBudget = 0; // Bytes of texel data kept resident, finer mip levels are streamed in as needed. 0 = all of it. Set before Init()
     
-private: 
+protected: 
+
+	RenderStats stats;
 
 	// Rendering:
+	uint32_t* framebuffer = nullptr;
 	float* depthBuffer = nullptr;
 
+	JobSystem* jobs = nullptr;
+	Rasterizer* rasterizer = nullptr;
+	GeometryPipeline* geometry = nullptr; // Front end of the rasterizer, RenderObject queues into it
+	FrameArena* frameArena = nullptr; // Per frame geometry, reset at the start of Render()
+	AssetLoader* assets = nullptr;
+	TextureStreamer* textureStreamer = nullptr; // Only with a textureBudget
+
 	// Time
 	std::chrono::high_resolution_clock::time_point previousTime;
 
@@ -142,16 +111,21 @@ private:
 	void Plot(uint32_t color, int pX, int pY);
 	void Line(uint32_t color, float x1, float y1, float x2, float y2);
 	void TriangleWireframe(uint32_t color, float x1, float y1, float x2, float y2, float x3, float y3);
-	void PlotTriangle(const Vertex& v1, const Vertex& v2, const Vertex& v3, const Mesh& mesh, const int matIndex);
 
-	std::vector<Triangle> CullBackFaces(std::vector<float3>& viewVertices, std::vector<Triangle>& triangles);
-	bool BackFacing(const Triangle& triangle, std::vector<float3>& viewVerts);
+	void RenderObject(Model* targetModel, uint32_t color, std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, std::span<const Triangle> triangles, const mat4& MV, const mat4& proj);
 	
-	void ClipTriangle();
-
-	void RenderObject(Model* targetModel, uint32_t color, std::vector<Vertex>& vertices, std::vector<Triangle>& triangles, const mat4& MV, const mat4& proj);
-	
-	float3 Trace(tinybvh::Ray& ray);
+	float3 Trace(tinybvh::Ray& ray, uint64_t& rayCount);
+	float3 Shade(const tinybvh::Ray& ray, uint64_t& rayCount);
+	uint32_t SampleHit(const tinybvh::Intersection& hit) const;
+	void TraceTile(int tileX, int tileY, uint64_t& rayCount);
+	void TracePacket(int pX, int pY, uint64_t& rayCount);
+
+	// Per thread counter on its own cache line
+	struct alignas(64) ThreadRayCount
+	{
+		uint64_t rays = 0;
+	};
+	std::vector<ThreadRayCount> threadRays;
 	void IntersectTri(Ray& ray, const Tri& tri);
 	Tri tri[TRI_N];
 
@@ -167,7 +141,7 @@ private:
 		float3 bottomLeft = float3(-aspect, -1, 0);
 		float3 forward;
 
-		float zNear = 0.1f;
+		float zNear = 1.0f, zFar = 500.0f; // Of the rasterizer's projection, geometry closer than zNear is clipped
 
 		float aspect = float(SCREEN_WIDTH) / float(SCREEN_HEIGHT);
 		float fovRad = 60 * (3.14159f / 180.0f);
@@ -213,13 +187,20 @@ private:
 	Model* testCharacter = nullptr;
 	Model* testFloor = nullptr;
 
-	std::vector<Model*> models;
+	std::vector<Model*> models; // Loaded ones, in the order they made it into the scene
 
-	tinybvh::BVH tlas;
+	// Queued on the loader, target is set to the model once it is added to the scene
+	struct PendingModel
+	{
+		ModelHandle handle;
+		Model** target;
+	};
+	std::vector<PendingModel> pendingModels; // In the order they were queued
 
-	std::vector<tinybvh::BVHBase*> bvh = { };
+	void LoadModel(const char* filePath, Model** target);
+	void AddLoadedModels(); // Moves finished loads into models and the scene, in queue order
 
-	std::vector<tinybvh::BLASInstance> blases = { };
+	SceneTracker scene; // Model i is instance i
 
 	float theta = 0.f; // used to rotate point light around model
 	std::vector<PointLight*> lights = { };
@@ -0,0 +1,84 @@
+#pragma once
+#include "Rasterizer.hpp"
+#include "VertexTransform.hpp"
+#include "FrameArena.hpp"
+#include "JobSystem.hpp"
+#include <atomic>
+
+// What the front end did in one frame
+struct GeometryStats
+{
+	uint64_t trianglesSubmitted = 0;
+	uint64_t trianglesRasterized = 0;
+	uint64_t trianglesClipped = 0;
+	uint64_t modelsCulled = 0;
+	uint64_t verticesProjected = 0;
+};
+
+// Front end of the rasterizer. Draws are queued during the frame and Run() puts all of
+// them through the JobSystem threads: vertices are transformed in VERTEX_BATCH_SIZE
+// chunks, then triangles are culled, clipped and set up in batches of up to
+// GEOMETRY_BATCH_SIZE triangles of one material, each into the frame arena region of the
+// thread that does it. A batch resolves the sampler of its material once, its triangles
+// point at it. The main thread bins
+// finished batches in submission order while the other threads are still working, so
+// the rasterizer sees the same triangles in the same order as a serial front end would.
+class GeometryPipeline
+{
+public:
+	GeometryPipeline(Rasterizer* rasterizer, JobSystem* jobs, FrameArena* frameArena);
+
+	// Forgets last frame's draws, after the arena was reset
+	void BeginFrame();
+
+	// The mesh and the spans have to stay alive until Run(). materials splits triangles into
+	// runs of one material (see Mesh::materialRanges), they are drawn in that order
+	void AddDraw(const Mesh& mesh, std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, std::span<const Triangle> triangles,
+		std::span<const MaterialRange> materials, const mat4& MV, const mat4& proj);
+
+	// Everything queued ends up binned in the rasterizer, Flush() it afterwards
+	GeometryStats Run();
+
+private:
+	struct Draw
+	{
+		const Mesh* mesh;
+		std::span<const tinybvh::bvhvec4> positions;
+		std::span<const float2> uvs;
+		std::span<const Triangle> triangles;
+		std::span<const MaterialRange> materials;
+		mat4 MV, proj;
+		TransformedVertices transformed;
+		uint32_t firstVertexChunk, firstBatch; // Into the chunks and batches of all draws
+	};
+
+	struct alignas(64) Batch
+	{
+		uint32_t draw;
+		uint32_t firstTriangle, triangleCount;
+		int materialIndex;
+		TextureSampler texture; // Of materialIndex, what the set up triangles point at
+
+		// Set up triangles in submission order, in the arena region of the thread that did the batch
+		RasterTriangle* output;
+		uint32_t outputCount;
+
+		uint32_t rasterized, clipped, clippedVertices; // Its share of GeometryStats
+
+		std::atomic<uint32_t> done;
+	};
+
+	void TransformChunk(uint32_t chunk);
+	void ProcessBatch(Batch& batch, ScratchRegion& scratch);
+	void BinFinishedBatches();
+
+	Rasterizer* rasterizer;
+	JobSystem* jobs;
+	FrameArena* frameArena;
+
+	std::vector<Draw> draws; // Keeps its capacity, queuing doesn't allocate after the first frames
+	uint32_t vertexChunkCount = 0;
+	std::span<Batch> batches;
+	uint32_t nextToBin = 0;
+	GeometryStats stats;
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool. The calling thread takes part in the work as thread 0,
+// so a pool of N threads spawns N - 1 workers.
+//
+// ParallelFor hands every thread a contiguous range of indices. A thread works through
+// its own range front to back and, once it runs dry, steals the back half of the range
+// of another thread. Neighbouring indices mostly stay on one thread and uneven work
+// still balances out.
+class JobSystem
+{
+public:
+	// Non-owning reference to a callable(uint32_t index, uint32_t threadIndex). ParallelFor
+	// blocks until the job is done, so the callable outlives it and nothing is copied to the heap
+	class Job
+	{
+	public:
+		template<typename Function>
+		Job(const Function& function)
+			: object(&function), call([](const void* f, uint32_t index, uint32_t threadIndex) { (*static_cast<const Function*>(f))(index, threadIndex); }) {}
+
+		void operator()(uint32_t index, uint32_t threadIndex) const { call(object, index, threadIndex); }
+
+	private:
+		const void* object;
+		void (*call)(const void* function, uint32_t index, uint32_t threadIndex);
+	};
+
+	JobSystem(uint32_t threadCount = 0); // 0 = one thread per hardware thread
+	~JobSystem();
+
+	// Runs job(i, thread) for i in [0, count) and blocks until all indices are done
+	void ParallelFor(uint32_t count, const Job& job);
+
+	uint32_t GetThreadCount() const { return threadCount; }
+
+	// Ranges stolen from other threads, since construction
+	uint64_t GetStealCount() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+	// [begin, end) packed as end << 32 | begin so owner and thieves can update it with one CAS
+	struct alignas(64) WorkRange
+	{
+		std::atomic<uint64_t> range{ 0 };
+	};
+
+	void WorkerLoop(uint32_t threadIndex);
+	void RunItems(uint32_t threadIndex);
+	bool PopItem(uint32_t threadIndex, uint32_t& index);
+	bool StealRange(uint32_t threadIndex);
+
+	uint32_t threadCount = 1;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const Job* job = nullptr;
+	std::vector<WorkRange> ranges; // One per thread
+	std::atomic<uint64_t> steals{ 0 };
+	uint32_t activeWorkers = 0;
+	uint64_t generation = 0;
+	bool quit = false;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <algorithm>
 #include <math.h>
 #include <fstream>
@@ -14,6 +16,10 @@
 #include "tinyBVH.hpp"
 #include "tiny_obj_loader.h"
 #include "Common.hpp"
+#include "MappedFile.hpp"
+#include "MeshOptimizer.hpp"
+#include <memory>
+#include <span>
 
 struct int2
 {
@@ -204,12 +210,12 @@ inline mat4 operator*(const mat4& A, const mat4& B)
 	return R;
 };
 
+// Vertex as the loaders build it, Mesh keeps every attribute in its own stream
 struct Vertex
 {
 	float3 position;
 	float2 uv;
 	float3 normal;
-	float4 pos4() const { return { position.x, position.y, position.z, 1.f }; };
 
 	bool operator==(const Vertex& other) const 
 	{
@@ -217,9 +223,6 @@ struct Vertex
 			uv == other.uv &&
 			normal == other.normal);
 	}
-
-	float invW;     // = 1 / c.w
-	float2 uvDivW;  // = uv * invW
 };
 
 struct Triangle
@@ -250,25 +253,262 @@ struct FaceGroup
 	int materialIndex = -1;  // Default to -1 = no material
 };
 
+// Triangles [firstTriangle, firstTriangle + triangleCount) of a mesh all use materialIndex
+struct MaterialRange
+{
+	int materialIndex;
+	uint32_t firstTriangle, triangleCount;
+};
+
+// Material of a mesh as stored on disk, textures are loaded from it after the geometry
+struct MeshMaterial
+{
+	std::string name;
+	std::string diffuseTexture; // Relative to the mesh file, empty = default texture
+	TextureAddress address = TextureAddress::Wrap;
+};
+
 class Mesh
 {
 public:
 	Mesh() = default;
-	Mesh(std::vector<Triangle> trianglesArg, std::vector<tinybvh::bvhvec4> fatTris, std::vector<Vertex> vertArg, std::vector<float2>texArg, std::vector<float3>normalArg, std::deque<FaceGroup> facesArg)
-		: fatTriangles(fatTris), triangle(trianglesArg), vertices(vertArg), texCoords(texArg), normals(normalArg), face_groups(facesArg) { };
-	std::vector<Vertex> vertices;
-	std::vector<float2> texCoords;
-	std::vector<float3> normals;
-	std::vector<Triangle> triangle;
-	std::vector<tinybvh::bvhvec4> fatTriangles;
-	std::deque<FaceGroup> face_groups;
-
+	Mesh(std::vector<Triangle> trianglesArg, std::vector<Vertex> vertArg) { SetGeometry(std::move(vertArg), std::move(trianglesArg)); };
+
+	// The views point into the storage below or into a mapped .srmesh file, so a mesh can
+	// only be moved, never copied
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
+
+	// One stream per vertex attribute. Positions are padded to 16 bytes (w = 0), so the BVH
+	// builds from them directly and the transform loads a vertex with one instruction
+	std::span<const tinybvh::bvhvec4> positions;
+	std::span<const float2> uvs;
+	std::span<const float3> normals;
+
+	std::span<const Triangle> triangle;
+	std::span<const uint32_t> indices; // 3 per triangle, the BVH input next to positions
+	float3 boundsMin = { 0.f, 0.f, 0.f }, boundsMax = { 0.f, 0.f, 0.f }; // Object space
+
+	std::vector<MeshMaterial> materials;
 	std::vector<Texture>textures;
 	int materialCount = 0;
 
+	// Triangles are grouped by material when the mesh is built, one range per run of a material
+	std::vector<MaterialRange> materialRanges;
+
+	// Texel data of all textures in material order once PackTextures ran, the textures point into it
+	std::vector<uint64_t, CacheLineAllocator<uint64_t>> textureArray;
+
+	// FIFO ACMR of the triangle order in the file and after OptimizeVertexOrder
+	float sourceACMR = 0.f, optimizedACMR = 0.f;
+
+	// Splits parsed geometry into the streams, derives the indices and the bounds
+	void SetGeometry(const std::vector<Vertex>& vertexArg, std::vector<Triangle> triangleArg)
+	{
+		triangleStorage = std::move(triangleArg);
+
+		positionStorage.clear();
+		uvStorage.clear();
+		normalStorage.clear();
+		positionStorage.reserve(vertexArg.size());
+		uvStorage.reserve(vertexArg.size());
+		normalStorage.reserve(vertexArg.size());
+		for (const Vertex& v : vertexArg)
+		{
+			positionStorage.push_back(tinybvh::bvhvec4{ v.position.x, v.position.y, v.position.z, 0.f });
+			uvStorage.push_back(v.uv);
+			normalStorage.push_back(v.normal);
+		}
+
+		indexStorage.clear();
+		indexStorage.reserve(triangleStorage.size() * 3);
+		for (const Triangle& t : triangleStorage)
+			for (int corner = 0; corner < 3; corner++) indexStorage.push_back(static_cast<uint32_t>(t.indices[corner]));
+
+		positions = positionStorage;
+		uvs = uvStorage;
+		normals = normalStorage;
+		triangle = triangleStorage;
+		indices = indexStorage;
+
+		boundsMin = boundsMax = vertexArg.empty() ? float3{ 0.f, 0.f, 0.f } : vertexArg[0].position;
+		for (const Vertex& v : vertexArg)
+		{
+			boundsMin = { std::min(boundsMin.x, v.position.x), std::min(boundsMin.y, v.position.y), std::min(boundsMin.z, v.position.z) };
+			boundsMax = { std::max(boundsMax.x, v.position.x), std::max(boundsMax.y, v.position.y), std::max(boundsMax.z, v.position.z) };
+		}
+
+		BuildMaterialRanges();
+	}
+
+	// materialRanges from the triangles as they are
+	void BuildMaterialRanges()
+	{
+		materialRanges.clear();
+		for (uint32_t i = 0; i < triangle.size(); i++)
+		{
+			if (materialRanges.empty() || materialRanges.back().materialIndex != triangle[i].materialIndex)
+				materialRanges.push_back({ triangle[i].materialIndex, i, 0 });
+			materialRanges.back().triangleCount++;
+		}
+	}
+
+	// Sampler of a material, the default texture for triangles without one
+	TextureSampler GetSampler(int materialIndex) const
+	{
+		bool hasMaterial = materialIndex >= 0 && materialIndex < static_cast<int>(textures.size());
+		return hasMaterial ? textures[materialIndex].GetSampler() : Texture::GetDefault().GetSampler();
+	}
+
+	// Moves the texel data of every texture into textureArray, each on its own cache lines.
+	// The material ranges of a draw then read one allocation front to back
+	void PackTextures()
+	{
+		size_t words = 0;
+		for (const Texture& texture : textures) words += (texture.GetMemorySize() + 63) / 64 * 8;
+		textureArray.assign(words, 0);
+
+		size_t offset = 0;
+		for (Texture& texture : textures)
+		{
+			size_t bytes = texture.GetMemorySize();
+			texture.MoveTo(textureArray.data() + offset);
+			offset += (bytes + 63) / 64 * 8;
+		}
+	}
+
+	// One texture per material, so material ids index textures directly
+	void LoadTextures(const std::string& baseDir)
+	{
+		ResetTextures();
+		for (size_t i = 0; i < materials.size(); i++) LoadTexture(i, baseDir);
+	}
+
+	// The default texture in the slot of every material, until LoadTexture fills it in
+	void ResetTextures()
+	{
+		textures.assign(materials.size(), Texture::GetDefault());
+		materialCount = static_cast<int>(materials.size());
+	}
+
+	// Decodes the texture of one material into its slot. Different slots can be loaded
+	// from different threads at the same time
+	void LoadTexture(size_t material, const std::string& baseDir)
+	{
+		const MeshMaterial& source = materials[material];
+		Texture tex = source.diffuseTexture.empty() ? Texture::GetDefault() : Texture(baseDir + source.diffuseTexture, baseDir + source.diffuseTexture);
+		tex.name = source.name;
+		tex.address = source.address;
+		textures[material] = std::move(tex);
+	}
+
+	std::shared_ptr<MappedFile> mapping; // Set when the geometry lives in a mapped .srmesh file
+
+private:
+	std::vector<tinybvh::bvhvec4> positionStorage;
+	std::vector<float2> uvStorage;
+	std::vector<float3> normalStorage;
+	std::vector<Triangle> triangleStorage;
+	std::vector<uint32_t> indexStorage;
+};
+
+// Hands out one index per distinct (position, uv, normal). Open addressing over the
+// vertex indices, the key is compared bitwise, so 0 and -0 only cost a missed weld
+class VertexWelder
+{
+public:
+	static constexpr size_t KEY_SIZE = offsetof(Vertex, normal) + sizeof(float3); // position, uv, normal
+	static_assert(offsetof(Vertex, position) == 0 && KEY_SIZE == 8 * sizeof(float), "Vertex key has to be 8 packed floats");
+
+	VertexWelder(size_t maxVertices)
+	{
+		size_t size = 16;
+		while (size < maxVertices * 2) size *= 2;
+		slots.assign(size, EMPTY);
+		mask = size - 1;
+	}
+
+	// Index of v in vertices, appended if it isn't there yet
+	uint32_t Add(const Vertex& v, std::vector<Vertex>& vertices)
+	{
+		for (size_t slot = Hash(v) & mask;; slot = (slot + 1) & mask)
+		{
+			uint32_t index = slots[slot];
+			if (index == EMPTY)
+			{
+				index = static_cast<uint32_t>(vertices.size());
+				slots[slot] = index;
+				vertices.push_back(v);
+				return index;
+			}
+			if (memcmp(&vertices[index], &v, KEY_SIZE) == 0) return index;
+		}
+	}
+
+private:
+	static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+
+	static uint32_t Hash(const Vertex& v)
+	{
+		uint32_t words[8];
+		memcpy(words, &v, KEY_SIZE);
+
+		uint32_t hash = 0x811C9DC5;
+		for (uint32_t word : words) hash = (hash ^ word) * 0x01000193 + (hash >> 15);
+
+		// Murmur3 finalizer, the low bits pick the slot
+		hash ^= hash >> 16; hash *= 0x85EBCA6B;
+		hash ^= hash >> 13; hash *= 0xC2B2AE35;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	std::vector<uint32_t> slots;
+	size_t mask = 0;
 };
 
-static Mesh LoadMeshTinyObj(const char* filePath)
+// Reorders the triangles for the post-transform cache and groups them by material, keeping
+// that order inside a material. Then renumbers the vertices in the order the triangles use
+// them. None of it changes what gets drawn
+static void OptimizeVertexOrder(std::vector<Vertex>& vertices, std::vector<Triangle>& triangles, float& sourceACMR, float& optimizedACMR)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	std::vector<uint32_t> indices;
+	indices.reserve(triangles.size() * 3);
+	for (const Triangle& t : triangles) indices.insert(indices.end(), { uint32_t(t.indices[0]), uint32_t(t.indices[1]), uint32_t(t.indices[2]) });
+
+	sourceACMR = MeshOptimizer::ACMR(indices, vertexCount);
+
+	std::vector<uint32_t> order = MeshOptimizer::OptimizeVertexCache(indices, vertexCount);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return triangles[a].materialIndex < triangles[b].materialIndex; });
+	std::vector<Triangle> orderedTriangles(triangles.size());
+	std::vector<uint32_t> orderedIndices(indices.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		orderedTriangles[i] = triangles[order[i]];
+		for (int c = 0; c < 3; c++) orderedIndices[i * 3 + c] = indices[order[i] * 3 + c];
+	}
+
+	std::vector<uint32_t> remap = MeshOptimizer::OptimizeVertexFetch(orderedIndices, vertexCount);
+	std::vector<Vertex> orderedVertices(vertexCount - std::count(remap.begin(), remap.end(), MeshOptimizer::UNUSED));
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != MeshOptimizer::UNUSED) orderedVertices[remap[v]] = vertices[v];
+	}
+	for (Triangle& t : orderedTriangles)
+		for (int c = 0; c < 3; c++) t.indices[c] = static_cast<int>(remap[t.indices[c]]);
+	for (uint32_t& index : orderedIndices) index = remap[index];
+
+	optimizedACMR = MeshOptimizer::ACMR(orderedIndices, static_cast<uint32_t>(orderedVertices.size()));
+
+	vertices = std::move(orderedVertices);
+	triangles = std::move(orderedTriangles);
+}
+
+// Geometry and material table of an OBJ, textures aren't loaded (see Mesh::LoadTextures)
+static inline Mesh ParseMeshTinyObj(const char* filePath)
 {
 	Mesh mesh;
 	std::string warn, err;
@@ -289,22 +529,16 @@ static Mesh LoadMeshTinyObj(const char* filePath)
 	if (!err.empty()) std::cerr << "ERR: " << err << std::endl;
 	if (!ret) throw std::runtime_error("Failed to load OBJ");
 
-	// Convert materials -> your Texture list
-	for (const auto& mat : materials) {
-		if (!mat.diffuse_texname.empty()) {
-			std::string texPath = base_dir + mat.diffuse_texname;
-			Texture tex(texPath, texPath);
-			tex.name = mat.name;
-			mesh.textures.push_back(tex);
-			mesh.materialCount++;
-		}
-	}
+	for (const auto& mat : materials)
+		mesh.materials.push_back(MeshMaterial{ mat.name, mat.diffuse_texname, mat.diffuse_texopt.clamp ? TextureAddress::Clamp : TextureAddress::Wrap });
 
-	// Build a flat list of vertices, normals, texcoords
-	std::unordered_map<std::string, int> uniqueVertexMap;
+	// Build an indexed list of vertices, corners with the same position, uv and normal are welded
 	std::vector<Vertex> finalVertices;
 	std::vector<Triangle> finalTriangles;
-	std::vector<tinybvh::bvhvec4> fatTris;
+
+	size_t cornerCount = 0;
+	for (const auto& shape : shapes) cornerCount += shape.mesh.indices.size();
+	VertexWelder welder(cornerCount);
 
 	for (const auto& shape : shapes) {
 		size_t index_offset = 0;
@@ -344,12 +578,7 @@ static Mesh LoadMeshTinyObj(const char* filePath)
 					};
 				}
 
-				// Reuse vertex if already exists (optional)
-				int finalIndex = static_cast<int>(finalVertices.size());
-				finalVertices.push_back(vert);
-				fatTris.push_back(tinybvh::bvhvec4{ vert.position.x, vert.position.y, vert.position.z, 0.f });
-
-				tri.indices[v] = finalIndex;
+				tri.indices[v] = static_cast<int>(welder.Add(vert, finalVertices));
 			}
 
 			finalTriangles.push_back(tri);
@@ -357,9 +586,8 @@ static Mesh LoadMeshTinyObj(const char* filePath)
 		}
 	}
 
-	mesh.triangle = finalTriangles;
-	mesh.vertices = finalVertices;
-	mesh.fatTriangles = fatTris;
+	OptimizeVertexOrder(finalVertices, finalTriangles, mesh.sourceACMR, mesh.optimizedACMR);
+	mesh.SetGeometry(finalVertices, std::move(finalTriangles));
 
 	return mesh;
 }
@@ -448,7 +676,6 @@ static inline Mesh LoadMesh(const char* filePath)
 	std::vector<float3> normals;
 	std::deque<FaceGroup> face_groups;
 	std::vector<Triangle> triangles;
-	std::vector<tinybvh::bvhvec4> fatTris;
 
 	face_groups.emplace_back();
 	FaceGroup* cur_face_group = &face_groups.back();
@@ -511,7 +738,6 @@ static inline Mesh LoadMesh(const char* filePath)
 			float3 vertex;
 			stream >> vertex.x >> vertex.y >> vertex.z;
 			vertices.push_back(Vertex{ vertex });
-			//fatTris.push_back(tinybvh::bvhvec4{ vertex.x, vertex.y, vertex.z, 0.f });
 		}
 		else if (type == "vt") // VERTEX TEXTURE COORD
 		{
@@ -580,7 +806,6 @@ static inline Mesh LoadMesh(const char* filePath)
 				v.normal = normals[fv.normalIndex];
 
 				int index = static_cast<int>(finalVertices.size());
-				fatTris.push_back(tinybvh::bvhvec4{ v.position.x, v.position.y, v.position.z, 0.f });
 
 				finalVertices.push_back(v);
 				t.indices[j] = index;
@@ -590,16 +815,11 @@ static inline Mesh LoadMesh(const char* filePath)
 		}
 	}
 
-	mesh.triangle = finalTriangles;
-	mesh.fatTriangles = fatTris;
-	mesh.vertices = finalVertices;
-	mesh.texCoords = texCoords;
-	mesh.normals = normals;
-	mesh.face_groups = face_groups;
+	mesh.SetGeometry(finalVertices, std::move(finalTriangles));
 
 	return mesh;
 
-	//return Mesh(finalTriangles, fatTris, finalVertices, texCoords, normals, face_groups);
+	//return Mesh(finalTriangles, finalVertices);
 };
 
 namespace mat
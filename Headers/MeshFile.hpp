@@ -0,0 +1,58 @@
+#pragma once
+#include "Math.hpp"
+
+// .srmesh: a mesh as the renderer keeps it in memory, so it can be mapped and used in place.
+//
+// MeshFileHeader, then 64 byte aligned sections:
+//   positions     vertexCount x bvhvec4, also the BVH input
+//   uvs           vertexCount x float2
+//   normals       vertexCount x float3
+//   triangles     triangleCount x Triangle
+//   indices       triangleCount x 3 x uint32_t, the BVH input
+//   materials     materialCount x MeshFileMaterial
+// Native endianness and struct layout, sizes of the structs are in the header and checked on load.
+constexpr uint32_t MESH_FILE_MAGIC = 0x534D5253; // "SRMS" in the first four bytes
+constexpr uint32_t MESH_FILE_VERSION = 6; // 6: triangles grouped by material
+
+struct MeshFileHeader
+{
+	uint32_t magic = MESH_FILE_MAGIC;
+	uint32_t version = MESH_FILE_VERSION;
+	uint32_t positionSize = sizeof(tinybvh::bvhvec4);
+	uint32_t triangleSize = sizeof(Triangle);
+
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	uint32_t materialCount = 0;
+	float sourceACMR = 0.f; // Mesh::sourceACMR and optimizedACMR, the source order isn't in the file
+	float optimizedACMR = 0.f;
+	uint32_t padding = 0;
+
+	float boundsMin[3] = {};
+	float boundsMax[3] = {};
+
+	uint64_t positionOffset = 0;
+	uint64_t uvOffset = 0;
+	uint64_t normalOffset = 0;
+	uint64_t triangleOffset = 0;
+	uint64_t indexOffset = 0;
+	uint64_t materialOffset = 0;
+	uint64_t fileSize = 0;
+};
+
+struct MeshFileMaterial
+{
+	char name[64];
+	char diffuseTexture[188]; // Relative to the .srmesh, empty = default texture
+	uint32_t address; // TextureAddress
+};
+
+namespace MeshFile
+{
+	// Geometry, bounds and material table of mesh. Textures are referenced by path only
+	bool Write(const char* filePath, const Mesh& mesh);
+
+	// Maps the file, the geometry spans of mesh point straight into the mapping.
+	// Textures still have to be loaded with Mesh::LoadTextures
+	bool Load(const char* filePath, Mesh& mesh);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Load time reordering of indexed triangle lists, 3 indices per triangle.
+namespace MeshOptimizer
+{
+	constexpr uint32_t UNUSED = 0xFFFFFFFF;
+
+	// Post-transform cache ACMR simulates, the classic hardware FIFO
+	constexpr uint32_t FIFO_CACHE_SIZE = 16;
+
+	// Average cache miss ratio: vertices transformed per triangle with a FIFO of cacheSize
+	// transformed vertices. 3 means no reuse, about 0.5 is the limit for a closed mesh
+	float ACMR(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = FIFO_CACHE_SIZE);
+
+	// Triangle order that keeps reusing recently transformed vertices, Tom Forsyth's
+	// "Linear-Speed Vertex Cache Optimisation". Returns the old triangle of every new position
+	std::vector<uint32_t> OptimizeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount);
+
+	// Numbers the vertices in the order the indices first use them, so vertex fetches walk
+	// memory forward. Returns the new index of every old vertex, UNUSED if nothing references it
+	std::vector<uint32_t> OptimizeVertexFetch(std::span<const uint32_t> indices, uint32_t vertexCount);
+}
@@ -1,20 +1,31 @@
 #pragma once
 #include "tinyBVH.hpp"
+#include <string>
 #include <vector>
 #include "Math.hpp"
 
 class Model
 {
 public:
-	Model(const char* filePath);
+	// Loads everything on the calling thread. With load false only the path is kept and
+	// running the stages below is up to the caller, the AssetLoader spreads them over its threads
+	Model(const char* filePath, bool load = true);
 	~Model() = default;
 
-	Mesh mesh;
+	// LoadGeometry comes first, the others only need the mesh and not each other
+	void LoadGeometry(); // Mesh and material table, every material gets the default texture
+	void LoadTexture(size_t material);
+	void BuildBVH(); // wideBVH, modelBVH and packetBVH
 
-	std::vector<float4> fatTriangles; // Fat Triangles For Tinybvh
+	std::string filePath;
+	std::string textureDirectory; // Texture paths of the materials are relative to it
+	bool compressTextures = false; // LoadTexture keeps them BC1 / BC3 compressed (see Texture::Compress)
+	Mesh mesh;
 
 	// BVH
-	tinybvh::BVH8_CPU* modelBVH;
+	tinybvh::BVH8_CPU* modelBVH = nullptr;
+	tinybvh::MBVH<8>* wideBVH = nullptr; // modelBVH is converted from it and shares its data
+	tinybvh::BVH* packetBVH = nullptr; // The indexed binary BVH wideBVH was converted from, BVH8_CPU has no packet traversal
 
 private:
 };
\ No newline at end of file
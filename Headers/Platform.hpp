@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+class Program;
+
+// Keys the platform layer forwards to the program, independent of the OS key codes
+enum class Key
+{
+	ToggleRenderMode,
+	Forward,
+	Backward,
+	Left,
+	Right,
+	Escape
+};
+
+enum class PlatformType
+{
+	Default,	// Win32 on Windows, headless everywhere else
+	Win32,
+	Headless
+};
+
+// OS layer beneath Program: window creation, message pump and presenting finished frames
+class Platform
+{
+public:
+	virtual ~Platform() = default;
+
+	virtual bool OpenWindow(int width, int height, const char* title) = 0;
+	virtual void PumpEvents(Program* program) = 0;
+	virtual void Present(const uint32_t* pixels, int width, int height) = 0;
+
+	virtual bool IsHeadless() const { return false; }
+};
+
+Platform* CreatePlatform(PlatformType type);
@@ -0,0 +1,36 @@
+#pragma once
+#include "Platform.hpp"
+#include <string>
+
+// Renders without a window. The last presented frame is exposed through GetFrame()
+// and can optionally be dumped to disk as binary PPM files.
+class HeadlessPlatform : public Platform
+{
+public:
+	HeadlessPlatform(int frameLimit = 0, const std::string& dumpDirectory = "");
+
+	bool OpenWindow(int width, int height, const char* title) override;
+	void PumpEvents(Program* program) override;
+	void Present(const uint32_t* pixels, int width, int height) override;
+
+	bool IsHeadless() const override { return true; }
+
+	// Finished frame in 0xAARRGGBB, valid until the next Render()
+	const uint32_t* GetFrame() const { return frame; }
+	int GetFrameWidth() const { return frameWidth; }
+	int GetFrameHeight() const { return frameHeight; }
+	int GetFrameCount() const { return frameCount; }
+
+	void SetFrameLimit(int limit) { frameLimit = limit; }
+	void SetDumpDirectory(const std::string& directory) { dumpDirectory = directory; }
+
+	static bool WritePPM(const char* filePath, const uint32_t* pixels, int width, int height);
+
+private:
+	const uint32_t* frame = nullptr;
+	int frameWidth = 0, frameHeight = 0;
+	int frameCount = 0;
+
+	int frameLimit = 0; // 0 = run until Quit()
+	std::string dumpDirectory;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#ifdef _WIN32
+#include "Platform.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define UNICODE
+#include <Windows.h>
+
+// Window + StretchDIBits presenting, the original desktop path
+class Win32Platform : public Platform
+{
+public:
+	Win32Platform();
+
+	bool OpenWindow(int width, int height, const char* title) override;
+	void PumpEvents(Program* program) override;
+	void Present(const uint32_t* pixels, int width, int height) override;
+
+private:
+	static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+	HWND window = nullptr;
+	BITMAPINFO bitmapInfo;
+
+	// Only valid while PumpEvents dispatches messages
+	Program* listener = nullptr;
+
+	const uint32_t* frame = nullptr;
+	int frameWidth = 0, frameHeight = 0;
+};
+#endif
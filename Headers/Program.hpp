@@ -1,10 +1,5 @@
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-#define UNICODE
-#include <Windows.h>
-
 #include <map>
 #include <unordered_map>
 #include <thread>
@@ -14,11 +9,12 @@
 
 #include "Common.hpp"
 #include "Logger.hpp"
+#include "Platform.hpp"
 
 class Program
 {
 public:
-	Program(const char* title);
+	Program(const char* title, Platform* platform);
 	virtual ~Program();
 
 	virtual void Init() {};
@@ -29,12 +25,19 @@ public:
 	virtual void HandleInput() = 0;
 	virtual void Quit();
 
+	// Called by the platform layer while pumping events
+	virtual void OnKeyDown(Key /*key*/) {}
+	virtual void OnKeyUp(Key /*key*/) {}
+
 	bool isRunning = true;
 
 protected:
 
+	const char* title;
+	Platform* platform = nullptr;
+
 	// Time
 	int milisecondsPreviousFrame;
 	double deltaTime;
 	float timeElapsed;
-};
\ No newline at end of file
+};
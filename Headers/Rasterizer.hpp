@@ -0,0 +1,164 @@
+#pragma once
+#include "Math.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
+
+// Subpixel precision of the snapped vertex positions
+constexpr int SUBPIXEL_BITS = 4;
+constexpr int SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;
+
+// Projected vertex, all the rasterizer reads of it
+struct ScreenVertex
+{
+	float x, y;	// Pixels
+	float z;	// NDC depth
+	float invW;	// 1 / w
+	float uDivW, vDivW; // uv / w
+};
+
+// Linear function over the screen, value = base + dx * x + dy * y (x, y in pixels)
+struct AttributePlane
+{
+	float base, dx, dy;
+
+	float At(float x, float y) const { return base + dx * x + dy * y; }
+};
+
+// Triangle after setup, everything the per pixel loop needs is computed once here.
+// Edge functions E(x, y) = A * x + B * y + C are evaluated in SUBPIXEL_BITS fixed point,
+// a pixel is covered when all three are >= 0. The top-left fill rule is folded into C.
+struct RasterTriangle
+{
+	int64_t A[3], B[3], C[3];
+	int minX, minY, maxX, maxY; // Inclusive pixel bounds, clamped to the screen
+	float minZ; // Lower bound of the depth of any covered pixel
+
+	AttributePlane invZ;	// 1 / z
+	AttributePlane invW;	// 1 / w
+	AttributePlane uDivW;	// u / w
+	AttributePlane vDivW;	// v / w
+
+	const TextureSampler* texture; // Diffuse texture of the material, bound once per batch of triangles with that material
+};
+
+// Color and depth buffer the kernels write into
+struct RasterTarget
+{
+	uint32_t* framebuffer;
+	float* depthBuffer;
+	int width;
+};
+
+// Rasterizes the part of a set up triangle inside [minX, maxX] x [minY, maxY]
+using PlotTriangleKernel = void(*)(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY);
+
+enum class RasterKernel
+{
+	Auto,	// Widest one the CPU supports
+	Scalar,
+	AVX2,
+	AVX512
+};
+
+// Triangles per chunk of a tile bin, a chunk is 512 bytes
+constexpr int BIN_CHUNK_SIZE = 62;
+
+// Work the hierarchical depth test saved, summed over all tiles
+struct OcclusionStats
+{
+	uint64_t trianglesOccluded = 0;	// Triangle parts rejected by the tile max depth
+	uint64_t blocksOccluded = 0;	// HIZ_BLOCK_SIZE blocks rejected by the block max depth
+};
+
+// Sort-middle rasterizer: triangles are binned into TILE_SIZE x TILE_SIZE screen tiles
+// and every tile is rasterized by one worker. A tile owns its part of the color and
+// depth buffer, so no locking is needed and each tile sees its triangles in submission
+// order, which keeps the output identical to a serial rasterizer.
+//
+// Next to the depth buffer it keeps the max depth of every HIZ_BLOCK_SIZE block and of
+// every tile. A triangle whose min depth is behind that max can't pass a single depth
+// test there, so it is skipped for the whole tile or block.
+class Rasterizer
+{
+public:
+	Rasterizer(uint32_t* framebuffer, float* depthBuffer, int width, int height, JobSystem* jobs);
+
+	// Clears the depth buffer and the coarse depth that goes with it
+	void ClearDepth(float depth);
+
+	// Triangles and bins of the frame live in scratch until the next BeginFrame()
+	void BeginFrame(ScratchRegion& scratch);
+	void Flush();
+
+	// Setup turns a screen space triangle into a RasterTriangle, false means nothing of it
+	// is on screen. It only reads the rasterizer, so any thread can set up triangles while
+	// the main thread bins. Bin adds a set up triangle to the tiles it covers and keeps the
+	// pointers to it and its texture until Flush(), triangles are drawn in the order they
+	// are binned
+	bool Setup(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const TextureSampler* texture, RasterTriangle& tri) const;
+	void Bin(const RasterTriangle* tri);
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+	int GetTileCountX() const { return tilesX; }
+	int GetTileCountY() const { return tilesY; }
+
+	// Picks the pixel kernel, falls back to the next narrower one the CPU supports
+	void SetKernel(RasterKernel requested);
+	RasterKernel GetKernel() const { return kernelType; }
+	static const char* GetKernelName(RasterKernel kernel);
+	static RasterKernel ParseKernelName(const char* name); // Unknown names map to Auto
+
+	void SetTextureFilter(TextureFilter filter);
+	TextureFilter GetTextureFilter() const { return textureFilter; }
+	static const char* GetTextureFilterName(TextureFilter filter);
+	static TextureFilter ParseTextureFilterName(const char* name); // Unknown names map to NearestMip
+
+	// Of the last Flush()
+	OcclusionStats GetOcclusionStats() const;
+
+private:
+	void SelectKernel();
+	bool SetupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, RasterTriangle& tri) const;
+	void RasterizeTile(uint32_t tileIndex);
+	bool BlockVisible(int blockIndex, float minZ, bool& refreshed);
+	float BlockMaxDepth(int blockIndex) const;
+
+	uint32_t* framebuffer;
+	float* depthBuffer;
+	int width, height;
+	int tilesX, tilesY;
+	int blocksX, blocksY;
+
+	JobSystem* jobs;
+
+	RasterKernel kernelType = RasterKernel::Scalar;
+	TextureFilter textureFilter = TextureFilter::NearestMip;
+	PlotTriangleKernel kernel = nullptr;
+
+	// Triangles of one tile in submission order, a list of chunks in frame arena memory
+	struct BinChunk
+	{
+		BinChunk* next;
+		uint32_t count;
+		const RasterTriangle* triangles[BIN_CHUNK_SIZE];
+	};
+
+	struct TileBin
+	{
+		BinChunk* first = nullptr;
+		BinChunk* last = nullptr;
+	};
+
+	ScratchRegion* scratch = nullptr;
+	std::vector<TileBin> bins;
+
+	// Max depth per block and per tile. Depth only decreases during a frame, so a stale
+	// value is still an upper bound: writes just mark the block dirty and the exact max is
+	// recomputed the next time a test against the stale one fails.
+	std::vector<float> blockMaxDepth;
+	std::vector<uint8_t> blockDirty;
+	std::vector<float> tileMaxDepth;
+	std::vector<OcclusionStats> tileStats;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "Rasterizer.hpp"
+
+// Lets a single function use AVX2 / AVX-512 intrinsics without building the whole
+// project for that instruction set. MSVC accepts the intrinsics without it.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx2,fma")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RASTERIZER_X64
+#endif
+
+// The kernels must give the same bits, so a * b + c can't become an FMA in one of them and
+// stay a multiply and an add in another. Holds for the functions defined after this include
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <cstring>
+
+// Index of the lowest set bit, bits must not be 0
+static inline int LowestBit(uint32_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+// Kernels are instantiated for every TextureFilter in their own translation unit
+
+// Scalar version, one pixel at a time. Fallback and reference for the SIMD kernels
+template<TextureFilter filter>
+void PlotTriangleScalar(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY);
+
+#ifdef RASTERIZER_X64
+// 8 pixels per iteration
+template<TextureFilter filter>
+TARGET_AVX2 void PlotTriangleAVX2(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY);
+
+// 16 pixels per iteration
+template<TextureFilter filter>
+TARGET_AVX512 void PlotTriangleAVX512(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY);
+#endif
+
+// Squared length of the longer texel space step of one pixel in x or y, in base level
+// texels. u = uDivW / invW, so du/dx = (d(uDivW)/dx - u * d(invW)/dx) / invW. w = 1 / invW
+static inline float TexelFootprint(const RasterTriangle& tri, float u, float v, float w)
+{
+	const TextureSampler& tex = *tri.texture;
+	float dudx = (tri.uDivW.dx - u * tri.invW.dx) * w * float(tex.width);
+	float dvdx = (tri.vDivW.dx - v * tri.invW.dx) * w * float(tex.height);
+	float dudy = (tri.uDivW.dy - u * tri.invW.dy) * w * float(tex.width);
+	float dvdy = (tri.vDivW.dy - v * tri.invW.dy) * w * float(tex.height);
+	return std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+}
+
+// round(log2(sqrt(footprint))) == (floor(log2(footprint)) + 1) / 2, and floor(log2) is just
+// the float exponent. Done on the bits so the SIMD kernels can do exactly the same
+static inline int NearestMipLevel(float footprint, int levelCount)
+{
+	footprint = footprint < 1e30f ? footprint : 1e30f; // Also catches NaN
+	uint32_t bits;
+	memcpy(&bits, &footprint, sizeof(bits));
+	int exponent = int((bits >> 23) & 0xFF) - 127;
+	return std::clamp((exponent + 1) >> 1, 0, levelCount - 1);
+}
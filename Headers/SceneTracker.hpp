@@ -0,0 +1,58 @@
+#pragma once
+#include "tinyBVH.hpp"
+#include "Math.hpp"
+#include <cstdint>
+#include <vector>
+
+// What the last Update() had to do to the top level BVH
+enum class TLASUpdate
+{
+	Skipped,	// Nothing moved
+	Refit,		// Moved instances, same tree with new bounds
+	Rebuild		// Instances added / removed, or refitting made the tree too loose
+};
+
+// Owns the instances of the scene and the TLAS over them. Instances that get a new
+// transform are marked dirty, the TLAS is only brought up to date in Update(), so a
+// frame that never traces rays doesn't pay for it at all.
+class SceneTracker
+{
+public:
+	// Returns the instance index. Indices stay valid until an instance is removed. packetBLAS
+	// is a binary BVH over the same indexed triangles as blas, what Intersect256Rays traverses
+	uint32_t AddInstance(uint32_t blasIdx, tinybvh::BVHBase* blas, const tinybvh::BVH* packetBLAS = nullptr);
+	// The last instance takes over the index of the removed one
+	void RemoveInstance(uint32_t instanceIdx);
+
+	// Object to world. Only marks the instance dirty if the matrix actually changed
+	void SetTransform(uint32_t instanceIdx, const mat4& transform);
+
+	// Skips, refits or rebuilds the TLAS, whatever is the least that makes it match the instances
+	TLASUpdate Update();
+
+	// tinybvh's Intersect256Rays, through the TLAS. The rays share their origin and are laid
+	// out like its packets: 4x4 blocks of 4x4 rays, rays 0, 51, 204 and 255 are the corners.
+	// Only instances whose bounds the packet reaches get its rays moved into their space
+	void Intersect256Rays(tinybvh::Ray* packet) const;
+
+	const tinybvh::BVH& GetTLAS() const { return tlas; }
+	const std::vector<tinybvh::BLASInstance>& GetInstances() const { return instances; }
+	uint32_t GetInstanceCount() const { return static_cast<uint32_t>(instances.size()); }
+
+	// Rebuild once refitting pushed the SAH cost this far above the cost right after the last build
+	float maxRefitCost = 1.3f;
+
+private:
+	void Rebuild();
+	void Refit();
+
+	tinybvh::BVH tlas;
+	std::vector<tinybvh::BLASInstance> instances;
+	std::vector<tinybvh::BVHBase*> blases; // Indexed by BLASInstance::blasIdx
+	std::vector<const tinybvh::BVH*> packetBlases; // Same
+
+	std::vector<uint32_t> dirtyInstances;
+	std::vector<uint8_t> dirty; // One per instance, keeps dirtyInstances free of duplicates
+	bool structureChanged = false;
+	float builtCost = 0.f;
+};
@@ -1,22 +1,288 @@
 #pragma once
 #include "stb_image.h"
+#include "Common.hpp"
+#include "TextureCacheModel.hpp"
 #include <string>
+#include <vector>
 #include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <atomic>
+#include <climits>
+
+enum class TextureFilter
+{
+    Nearest,    // Base level, point sampled
+    NearestMip, // Closest mip level, point sampled
+    Bilinear,   // Closest mip level, bilinear
+    Trilinear   // Bilinear in the two closest mip levels, blended
+};
+
+// What happens to texture coordinates outside [0, 1], chosen per material
+enum class TextureAddress : uint32_t
+{
+    Wrap,   // The texture repeats, what OBJ materials do unless the MTL says "-clamp on"
+    Clamp,  // The edge texels stretch out
+    Mirror  // Repeats with every other copy flipped
+};
+
+// How a texture keeps its texels in memory. BC1 and BC3 are the usual GPU block formats:
+// every 4x4 tile is one 8 byte block (BC1, colors only) or 16 byte block (BC3, BC1 colors
+// after 8 bytes of alpha), against 64 bytes uncompressed
+enum class TextureFormat
+{
+    RGBA8,
+    BC1,
+    BC3
+};
+
+// Texels are stored in TEXTURE_TILE_SIZE x TEXTURE_TILE_SIZE tiles of 64 bytes, one cache
+// line each. Tiles are in row major order and so are the texels inside a tile, every level
+// is padded to whole tiles. A triangle that walks a texture along v then gets 4 texels out
+// of a line instead of 1, the same as along u
+constexpr int TEXTURE_TILE_SHIFT = 2;
+constexpr int TEXTURE_TILE_SIZE = 1 << TEXTURE_TILE_SHIFT;
+
+// Texels from one row of tiles to the next
+inline int TiledRowPitch(int width)
+{
+    return ((width + TEXTURE_TILE_SIZE - 1) & ~(TEXTURE_TILE_SIZE - 1)) << TEXTURE_TILE_SHIFT;
+}
+
+// Index of texel x, y in a level that is width texels wide
+inline int TiledTexelIndex(int x, int y, int width)
+{
+    const int mask = TEXTURE_TILE_SIZE - 1;
+    return (y >> TEXTURE_TILE_SHIFT) * TiledRowPitch(width) + ((x & ~mask) << TEXTURE_TILE_SHIFT) + ((y & mask) << TEXTURE_TILE_SHIFT) + (x & mask);
+}
+
+// Texels of a level with its padding
+inline int TiledLevelSize(int width, int height)
+{
+    return TiledRowPitch(width) * ((height + TEXTURE_TILE_SIZE - 1) >> TEXTURE_TILE_SHIFT);
+}
+
+// Puts texel storage on a cache line boundary, so the tiles are exactly the lines
+template<typename T>
+struct CacheLineAllocator
+{
+    using value_type = T;
+    static constexpr std::align_val_t ALIGNMENT{ 64 };
+
+    CacheLineAllocator() = default;
+    template<typename U> CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), ALIGNMENT)); }
+    void deallocate(T* memory, size_t) { ::operator delete(memory, ALIGNMENT); }
+
+    template<typename U> bool operator==(const CacheLineAllocator<U>&) const { return true; }
+};
+
+// One level of a mip chain, offset is in texels from the first resident level
+// (see Texture::residentLevel), levels before it have negative offsets
+struct MipLevel
+{
+    int offset;
+    int width, height;
+};
+
+// A block some thread decoded, see TextureSampler::GetBlock
+struct DecodedBlock
+{
+    uint32_t block = 0; // Numbered across all textures (see Texture::firstBlock), 0 = empty
+    uint32_t texels[16]; // Row major
+};
+static_assert(offsetof(DecodedBlock, block) == 0, "The SIMD kernels read the block number at the start of an entry");
+
+constexpr int DECODED_BLOCK_CACHE_BITS = 6;
+constexpr size_t DECODED_BLOCK_CACHE_SIZE = size_t(1) << DECODED_BLOCK_CACHE_BITS; // 4 KiB per thread, stays in L1
+
+// Blocks this thread decoded last, direct mapped by block number
+inline thread_local DecodedBlock decodedBlocks[DECODED_BLOCK_CACHE_SIZE];
+
+// Entry of a block number in decodedBlocks. Multiplicative hashing, so neighbouring blocks
+// land in different entries. The SIMD kernels do the same
+inline uint32_t DecodedBlockSlot(uint32_t block)
+{
+    return (block * 0x9E3779B1u) >> (32 - DECODED_BLOCK_CACHE_BITS);
+}
+
+// Finest mip level the pixel kernels wanted from a texture since the last Reset, before it
+// was clamped to the resident ones. Every tile a triangle is drawn in records into it
+struct TextureFeedback
+{
+    std::atomic<int> finestLevel{ INT_MAX };
+
+    void Record(int level)
+    {
+        int current = finestLevel.load(std::memory_order_relaxed);
+        while (level < current && !finestLevel.compare_exchange_weak(current, level, std::memory_order_relaxed)) {}
+    }
+
+    int Reset() { return finestLevel.exchange(INT_MAX, std::memory_order_relaxed); } // INT_MAX = not sampled
+};
+
+// Everything a pixel loop needs to read a texture, resolved once per triangle.
+// Fetch does no checks, x and y have to be in [0, widthMask] x [0, heightMask].
+struct TextureSampler
+{
+    const uint32_t* texels = nullptr; // 0xAARRGGBB, tiled (see TiledTexelIndex). All levels, base level first
+    const uint64_t* blocks = nullptr; // Instead of texels when the texture is block compressed
+    TextureFormat format = TextureFormat::RGBA8;
+    uint32_t firstBlock = 0; // See Texture::firstBlock
+    int width = 0, height = 0;
+    int widthMask = 0, heightMask = 0; // width - 1 and height - 1, the wrap masks for power of two sizes
+
+    const MipLevel* levels = nullptr;
+    int levelCount = 0;
+    int minLevel = 0; // Finest resident level, finer ones are sampled from it instead
+    TextureFeedback* feedback = nullptr; // Set when the texture is streamed, the kernels record the levels they wanted
+
+    TextureAddress address = TextureAddress::Wrap;
+
+    uint32_t Fetch(int x, int y) const
+    {
+        if (blocks) return FetchCompressed(0, x, y);
+        return Read(texels + TiledTexelIndex(x, y, width));
+    }
+    uint32_t Fetch(int level, int x, int y) const
+    {
+        if (blocks) return FetchCompressed(level, x, y);
+        return Read(texels + levels[level].offset + TiledTexelIndex(x, y, levels[level].width));
+    }
+
+    // Any u or v into [0, 1] by the address mode, the Sample functions expect that
+    float Address(float u) const
+    {
+        switch (address)
+        {
+        case TextureAddress::Wrap: return u - std::floor(u);
+        case TextureAddress::Mirror:
+        {
+            float m = u - 2.f * std::floor(u * 0.5f); // [0, 2)
+            return m > 1.f ? 2.f - m : m;
+        }
+        default: return std::clamp(u, 0.f, 1.f);
+        }
+    }
+
+    // Columns or rows x and x + 1 of a bilinear footprint, x is -1 to size - 1 for addressed
+    // coordinates. Clamp and Mirror both keep the edge texel, Wrap takes the one from the
+    // other side. Anything else (NaN coordinates) still ends up inside the level
+    void AddressPair(int x, int size, int& x0, int& x1) const
+    {
+        if (address == TextureAddress::Wrap)
+        {
+            x0 = x >= 0 && x < size ? x : size - 1;
+            x1 = x + 1 >= 0 && x + 1 < size ? x + 1 : 0;
+        }
+        else
+        {
+            x0 = std::clamp(x, 0, size - 1);
+            x1 = std::clamp(x + 1, 0, size - 1);
+        }
+    }
+
+    uint32_t SampleNearest(float u, float v, int level) const
+    {
+        const MipLevel& mip = levels[level];
+        int x = std::min(int(u * float(mip.width)), mip.width - 1);
+        int y = std::min(int(v * float(mip.height)), mip.height - 1);
+        return Fetch(level, x, y);
+    }
+
+    // Same texel centers as SampleNearest. The SIMD kernels give the same bits
+    uint32_t SampleBilinear(float u, float v, int level) const;
+    uint32_t SampleTrilinear(float u, float v, float lod) const;
+
+    // A block of a block compressed texture, decoded into decodedBlocks of the calling
+    // thread unless it is there already. A pixel loop reads the same few blocks over and over
+    const DecodedBlock& GetBlock(uint32_t block) const
+    {
+        DecodedBlock& entry = decodedBlocks[DecodedBlockSlot(firstBlock + block)];
+        if (entry.block != firstBlock + block) Decode(block, entry);
+        return entry;
+    }
+
+private:
+    // Blocks are the tiles, texel i of the chain is texel i % 16 of block i / 16
+    uint32_t FetchCompressed(int level, int x, int y) const
+    {
+        uint32_t index = uint32_t(levels[level].offset + TiledTexelIndex(x, y, levels[level].width));
+        return GetBlock(index >> 4).texels[index & 15];
+    }
+
+    void Decode(uint32_t block, DecodedBlock& entry) const;
+
+    static uint32_t Read(const uint32_t* texel)
+    {
+#ifdef MEASURE_TEXTURE_CACHE
+        TextureCacheModel::Read(texel);
+#endif
+        return *texel;
+    }
+};
 
 class Texture
 {
 public:
     std::string name; // Material name (not filepath)
-    int width = 0, height = 0, nrChannels = 0;
-    uint8_t* buffer = nullptr;
+    int width = 0, height = 0, nrChannels = 0; // nrChannels of the source image, texels are always RGBA8
+    TextureFormat format = TextureFormat::RGBA8;
+    std::vector<uint32_t, CacheLineAllocator<uint32_t>> texels; // 0xAARRGGBB, the whole mip chain, tiled. Empty once compressed
+    std::vector<uint64_t, CacheLineAllocator<uint64_t>> blocks; // The whole mip chain as BC1 / BC3 blocks, one per tile, mips keep their offsets
+    const void* packed = nullptr; // Texel data in a texture array (see MoveTo), texels and blocks are empty then
+    uint32_t firstBlock = 0; // Number of the first resident block, decoded blocks are cached by it. Every new texture takes numbers after the ones before
+    std::vector<MipLevel> mips; // Down to 1x1, mips[0] is the image itself
+    int residentLevel = 0; // Levels before it have no texels, see DropLevels
+    TextureFeedback* feedback = nullptr; // Set while a TextureStreamer manages the texture
+    TextureAddress address = TextureAddress::Wrap; // Of the material, handed to the sampler
 
     Texture(const std::string& filePath, const std::string& materialName);
+    Texture(int width, int height, const uint32_t* texels, const std::string& materialName);
+    Texture(const Texture&) = default;
+    Texture(Texture&&) = default; // Decoded textures are moved into their material slot, not copied
+    Texture& operator=(const Texture&) = default;
+    Texture& operator=(Texture&&) = default;
     ~Texture();
 
     uint8_t GetTexel(int x, int y, int channel = 0) const;
 
-    bool IsValid() const { return buffer != nullptr; }
+    bool IsValid() const { return !texels.empty() || !blocks.empty() || packed; }
+
+    // Replaces the texels with BC3 blocks if any texel isn't opaque, with BC1 blocks otherwise.
+    // Lossy, endpoints are picked along the main axis of the colors of each block. The blocks
+    // are numbered from blockNumber, 0 takes new numbers after the ones before
+    void Compress(uint32_t blockNumber = 0);
+
+    // Frees the texels of the levels before level, the sampler falls back to level for them.
+    // A packed texture gets its own storage again
+    void DropLevels(int level);
+
+    // Copies the texel data to dest, which holds GetMemorySize() bytes on a cache line
+    // boundary and has to outlive the texture, and samples it from there
+    void MoveTo(void* dest);
+
+    // Texels or blocks, depending on the format
+    const void* GetData() const;
+
+    // Bytes of texel data, all resident levels
+    size_t GetMemorySize() const { return GetMemorySize(residentLevel); }
+    // Bytes levels level to the last one take in the format of the texture, resident or not
+    size_t GetMemorySize(int level) const;
+
+    int GetWidth() const { return width; };
+    int GetHeight() const { return height; };
+
+    // Invalid textures resolve to the default one
+    TextureSampler GetSampler() const;
+
+    // 1x1 white, used for triangles without a (loadable) material
+    static const Texture& GetDefault();
 
-    int GetWidth() { return width; };
-    int GetHeight() { return height; };
-};
\ No newline at end of file
+private:
+    void GenerateMips();
+    void TileLevels();
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+// Simulated L1 data cache that the texel reads of TextureSampler go through when
+// MEASURE_TEXTURE_CACHE is defined in Common.hpp: 32 KiB, 8 ways, 64 byte lines, LRU, one
+// per thread, texels only (for block compressed textures the blocks that get decoded, the
+// per thread cache of decoded blocks counts as L1 resident). Hardware cache counters aren't available on every machine, this
+// gives comparable numbers everywhere. The SIMD kernels gather texels themselves and aren't
+// seen, measure with --kernel scalar
+namespace TextureCacheModel
+{
+	struct Counts
+	{
+		uint64_t reads = 0;
+		uint64_t misses = 0;
+		uint64_t pixels = 0; // Textured pixels that were written
+	};
+
+	void Read(const void* address);
+	void CountPixel();
+
+	// Summed over all threads since the last Reset(), all 0 without MEASURE_TEXTURE_CACHE
+	Counts GetCounts();
+	void Reset();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Model.hpp"
+#include "AssetLoader.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What the TextureStreamer did in one Update()
+struct TextureStreamingStats
+{
+	uint64_t loadsRequested = 0;	// Finer levels queued on the loader
+	uint64_t loadsCompleted = 0;	// Loaded levels swapped into their texture
+	uint64_t levelsEvicted = 0;		// Finest levels dropped to stay within the budget
+	size_t residentBytes = 0;		// Texel data of the streamed textures afterwards
+	size_t budget = 0;
+};
+
+// Keeps the texel data of the textures of the loaded models within a byte budget. The
+// pixel kernels record the finest mip level every tile wanted from a texture (see
+// TextureFeedback). Between frames Update() reads that back, drops the finest level of the
+// least recently used textures while over the budget and has the asset loader decode the
+// levels that were wanted but aren't resident. Until they arrive, the kernels sample the
+// finest level that is (TextureSampler::minLevel). A texture never drops its last level.
+class TextureStreamer
+{
+public:
+	TextureStreamer(AssetLoader* loader, size_t budget);
+
+	// Streams the textures of model from now on, they have to be fully loaded. Textures
+	// without a file stay as they are
+	void AddModel(Model* model);
+
+	// Call between frames, on the thread that renders
+	TextureStreamingStats Update();
+
+	size_t GetBudget() const { return budget; }
+	size_t GetResidentBytes() const { return residentBytes; }
+
+private:
+	struct Entry
+	{
+		Texture* texture;
+		std::string filePath;
+		TextureFeedback feedback;
+		uint64_t lastUsed = 0; // Frame the kernels last sampled it in
+		int wantedLevel = 0; // Finest level asked for in that frame
+		size_t reserved = 0; // Bytes a load in flight will add, 0 = none
+	};
+
+	// Filled in by the loader threads, shared so loads in flight outlive the streamer
+	struct Completed
+	{
+		std::mutex mutex;
+		std::vector<std::pair<size_t, Texture>> loads; // Entry index, texture with the loaded levels
+	};
+
+	void ApplyLoads(TextureStreamingStats& stats);
+	void RequestLoad(size_t index, int level, TextureStreamingStats& stats);
+
+	// Evicts levels until bytes more fit into the budget. Textures used this frame only give
+	// up levels finer than they wanted, unless anyUsed is set. skip and textures with a load
+	// in flight keep their levels
+	bool MakeRoom(size_t bytes, const Entry* skip, bool anyUsed, TextureStreamingStats& stats);
+
+	AssetLoader* loader;
+	size_t budget;
+	size_t residentBytes = 0, reservedBytes = 0;
+	uint64_t frame = 0;
+
+	std::deque<Entry> entries; // Textures point at their feedback, so entries don't move
+	std::shared_ptr<Completed> completed;
+	std::vector<std::pair<size_t, Texture>> applying; // Keeps its capacity between frames
+};
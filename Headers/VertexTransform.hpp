@@ -0,0 +1,38 @@
+#pragma once
+#include "Rasterizer.hpp"
+#include "FrameArena.hpp"
+#include "Clipping.hpp"
+
+// Per frame vertices of one draw, one array per attribute in frame arena memory. Mesh
+// vertex i is entry i.
+struct TransformedVertices
+{
+	// Clip space and its outcode, what culling and clipping read
+	std::span<float> clipX, clipY, clipZ, clipW;
+	std::span<uint32_t> clipCode;
+
+	// Screen space, what the rasterizer reads. Vertices with w close to 0 are all zeros
+	std::span<float> screenX, screenY, depth, invW, uDivW, vDivW;
+
+	size_t count = 0;
+
+	void Allocate(ScratchRegion& scratch, size_t capacity);
+	size_t Size() const { return count; }
+
+	// Entries [first, first + size) as their own, empty TransformedVertices. Lets threads
+	// transform parts of one draw
+	TransformedVertices Slice(size_t first, size_t size) const;
+
+	float4 ClipPosition(uint32_t i) const { return { clipX[i], clipY[i], clipZ[i], clipW[i] }; }
+	ScreenVertex GetScreenVertex(uint32_t i) const { return { screenX[i], screenY[i], depth[i], invW[i], uDivW[i], vDivW[i] }; }
+};
+
+// Screen space of a clip space position on a width x height target, the same bits
+// TransformVertices gives
+ScreenVertex ProjectToScreen(const float4& clip, const float2& uv, int width, int height);
+
+// Transforms positions by MV into view space and from there by proj into clip space and
+// screen space of a width x height target, out needs room for all of them. The AVX2
+// version does 8 vertices per iteration and gives the same bits as the scalar one
+void TransformVertices(std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, const mat4& MV, const mat4& proj,
+	int width, int height, bool useAVX2, TransformedVertices& out);
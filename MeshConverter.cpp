@@ -0,0 +1,34 @@
+#include "MeshFile.hpp"
+#include "Logger.hpp"
+#include <string>
+
+// Offline OBJ -> .srmesh conversion. Model picks up "<name>.srmesh" next to "<name>.obj"
+// on its own, so converting in place is all it takes.
+//
+// Usage: MeshConverter input.obj [output.srmesh]
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		Logger::Error("Usage: MeshConverter input.obj [output.srmesh]");
+		return 1;
+	}
+
+	std::filesystem::path inputPath(argv[1]);
+	std::filesystem::path outputPath = argc > 2 ? std::filesystem::path(argv[2]) : std::filesystem::path(inputPath).replace_extension(".srmesh");
+
+	Mesh mesh = ParseMeshTinyObj(inputPath.string().c_str());
+
+	// Texture paths stay relative to the OBJ, so the output has to end up in the same directory
+	if (std::filesystem::absolute(outputPath).parent_path() != std::filesystem::absolute(inputPath).parent_path())
+		Logger::Error("Warning: " + outputPath.string() + " is not next to the OBJ, texture paths won't resolve");
+
+	if (!MeshFile::Write(outputPath.string().c_str(), mesh))
+	{
+		Logger::Error("Cannot write " + outputPath.string());
+		return 1;
+	}
+
+	Logger::Log(outputPath.string() + ": " + std::to_string(mesh.positions.size()) + " vertices, " + std::to_string(mesh.triangle.size()) + " triangles, " + std::to_string(mesh.materials.size()) + " materials");
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include "AllocationCounter.hpp"
+#include "Common.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+static std::atomic<uint64_t> allocationCount{ 0 };
+
+namespace AllocationCounter
+{
+	uint64_t GetCount() { return allocationCount.load(std::memory_order_relaxed); }
+}
+
+// The array and nothrow forms of the standard library forward to these
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+	if (void* memory = _aligned_malloc(size ? size : 1, align)) return memory;
+#else
+	if (void* memory = std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align)) return memory;
+#endif
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+#ifdef _MSC_VER
+void operator delete(void* memory, std::align_val_t) noexcept { _aligned_free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { _aligned_free(memory); }
+#else
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+#endif
+#else
+namespace AllocationCounter
+{
+	uint64_t GetCount() { return 0; }
+}
+#endif
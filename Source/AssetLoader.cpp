@@ -0,0 +1,186 @@
+#include "AssetLoader.hpp"
+#include "Logger.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+AssetLoader::AssetLoader(uint32_t threadCount, bool compressTextures, bool packTextures)
+	: compressTextures(compressTextures), packTextures(packTextures)
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	threadCount = std::max(1u, threadCount);
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		workers.emplace_back(&AssetLoader::WorkerLoop, this);
+}
+
+Model* ModelHandle::Wait() const
+{
+	try
+	{
+		return future.get();
+	}
+	catch (const std::exception&)
+	{
+		return nullptr;
+	}
+}
+
+std::string ModelHandle::GetError() const
+{
+	if (!IsReady()) return {};
+	try
+	{
+		future.get();
+		return {};
+	}
+	catch (const std::exception& e)
+	{
+		return e.what();
+	}
+}
+
+AssetLoader::ModelLoad::~ModelLoad()
+{
+	if (delivered) return;
+
+	delete model;
+	promise.set_exception(std::make_exception_ptr(std::runtime_error("Loading was cancelled")));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+ModelHandle AssetLoader::LoadModel(const std::string& filePath)
+{
+	auto load = std::make_shared<ModelLoad>();
+	load->model = new Model(filePath.c_str(), false);
+	load->model->compressTextures = compressTextures;
+	load->start = std::chrono::steady_clock::now();
+
+	ModelHandle handle;
+	handle.future = load->promise.get_future().share();
+
+	Enqueue([this, load] { LoadGeometry(load); });
+	return handle;
+}
+
+void AssetLoader::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			wake.wait(lock, [this] { return quit || !tasks.empty(); });
+			if (quit) return;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		// Model loads deliver their own errors (RunTask), this keeps anything else from taking the process down
+		try
+		{
+			task();
+		}
+		catch (const std::exception& e)
+		{
+			Logger::Error(std::string("Loader task failed: ") + e.what());
+		}
+	}
+}
+
+void AssetLoader::LoadGeometry(const std::shared_ptr<ModelLoad>& load)
+{
+	Model* model = load->model;
+	RunTask(*load, [model] { model->LoadGeometry(); });
+	if (load->error)
+	{
+		// Nothing to build the rest from
+		load->tasksLeft.store(1);
+		FinishTask(*load);
+		return;
+	}
+
+	// Textures and the BVH only read the mesh, they don't have to wait for each other
+	size_t materialCount = model->mesh.materials.size();
+	load->tasksLeft.store(static_cast<uint32_t>(materialCount) + 1);
+
+	for (size_t i = 0; i < materialCount; i++)
+	{
+		Enqueue([this, load, i]
+			{
+				RunTask(*load, [&] { load->model->LoadTexture(i); });
+				FinishTask(*load);
+			});
+	}
+
+	Enqueue([this, load]
+		{
+			RunTask(*load, [&] { load->model->BuildBVH(); });
+			FinishTask(*load);
+		});
+}
+
+void AssetLoader::RunTask(ModelLoad& load, const std::function<void()>& task)
+{
+	try
+	{
+		task();
+	}
+	catch (const std::exception&)
+	{
+		std::lock_guard<std::mutex> lock(load.errorMutex);
+		if (!load.error) load.error = std::current_exception();
+	}
+}
+
+void AssetLoader::FinishTask(ModelLoad& load)
+{
+	// The last task hands the model over, everything written before is visible to whoever gets it
+	if (load.tasksLeft.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+	load.delivered = true;
+	if (load.error)
+	{
+		try
+		{
+			std::rethrow_exception(load.error);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::Error("Failed to load " + load.model->filePath + ": " + e.what());
+		}
+
+		delete load.model;
+		load.model = nullptr;
+		load.promise.set_exception(load.error);
+		return;
+	}
+
+	if (packTextures) load.model->mesh.PackTextures();
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load.start).count();
+	Logger::Log("Loaded " + load.model->filePath + " in " + std::to_string(static_cast<int>(ms)) + " ms");
+
+	load.promise.set_value(load.model);
+}
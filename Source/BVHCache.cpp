@@ -0,0 +1,119 @@
+#include "BVHCache.hpp"
+#include "Logger.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <system_error>
+#include <thread>
+
+namespace BVHCache
+{
+	// Bump when the way the cached tree is built changes
+	constexpr uint32_t BUILD_SETTINGS_VERSION = 2;
+	constexpr uint32_t LEAF_SIZE = 4;
+
+	static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		// FNV-1a
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	// Size Save() writes for this tree, tinybvh's Load() doesn't notice truncated files
+	static uintmax_t SavedSize(const tinybvh::BVH& bvh)
+	{
+		return 2 * sizeof(uint32_t) + sizeof(tinybvh::BVH) + bvh.usedNodes * sizeof(tinybvh::BVH::BVHNode) + bvh.idxCount * sizeof(uint32_t);
+	}
+
+	uint64_t Key(std::span<const tinybvh::bvhvec4> vertices, std::span<const uint32_t> indices)
+	{
+		// The file is a raw copy of the BVH object, so its layout is part of the key as well
+		const uint32_t settings[] = { BUILD_SETTINGS_VERSION, LEAF_SIZE, TINY_BVH_VERSION_MAJOR, TINY_BVH_VERSION_MINOR, TINY_BVH_VERSION_SUB,
+			static_cast<uint32_t>(sizeof(tinybvh::BVH)), static_cast<uint32_t>(sizeof(void*)) };
+
+		uint64_t hash = 0xCBF29CE484222325ull;
+		hash = HashBytes(hash, settings, sizeof(settings));
+		hash = HashBytes(hash, vertices.data(), vertices.size_bytes());
+		hash = HashBytes(hash, indices.data(), indices.size_bytes());
+		return hash;
+	}
+
+	std::string PathFor(const std::string& assetPath, uint64_t key)
+	{
+		char hex[17];
+		snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+		return assetPath + "." + hex + ".bvh";
+	}
+
+	static tinybvh::bvhvec4slice Slice(std::span<const tinybvh::bvhvec4> vertices)
+	{
+		return tinybvh::bvhvec4slice(vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(tinybvh::bvhvec4));
+	}
+
+	static bool Load(const std::string& path, std::span<const tinybvh::bvhvec4> vertices, std::span<const uint32_t> indices, tinybvh::BVH& bvh)
+	{
+		std::error_code error;
+		uintmax_t fileSize = std::filesystem::file_size(path, error);
+		if (error || fileSize < SavedSize(tinybvh::BVH())) return false;
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (!bvh.Load(path.c_str(), Slice(vertices), indices.data(), triangleCount))
+		{
+			// A failed Load has already copied the pointers stored in the file into bvh
+			bvh = tinybvh::BVH();
+			return false;
+		}
+
+		if (fileSize != SavedSize(bvh))
+		{
+			Logger::Error("Truncated BVH cache " + path);
+			tinybvh::BVH loaded = bvh; // Shallow copy, frees the loaded nodes when it goes out of scope
+			bvh = tinybvh::BVH();
+			return false;
+		}
+
+		return true;
+	}
+
+	static void Save(const std::string& path, tinybvh::BVH& bvh)
+	{
+		// Unique per process and thread, concurrent writers never share a temporary file
+		std::random_device random;
+		uint64_t unique = (static_cast<uint64_t>(random()) << 32) ^ random() ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+		std::string tempPath = PathFor(path, unique) + ".tmp";
+
+		bvh.Save(tempPath.c_str());
+
+		std::error_code error;
+		if (std::filesystem::file_size(tempPath, error) == SavedSize(bvh) && !error)
+		{
+			// Replaces the file in one step. Losing the race against another process is fine,
+			// whoever renames last wrote the same tree
+			std::filesystem::rename(tempPath, path, error);
+			if (!error) return;
+		}
+
+		Logger::Error("Cannot write BVH cache " + path);
+		std::filesystem::remove(tempPath, error);
+	}
+
+	bool LoadOrBuildHQ(const std::string& assetPath, std::span<const tinybvh::bvhvec4> vertices, std::span<const uint32_t> indices, tinybvh::BVH& bvh)
+	{
+		std::string path = PathFor(assetPath, Key(vertices, indices));
+
+		if (Load(path, vertices, indices, bvh))
+		{
+			Logger::Log("Loaded BVH cache " + path);
+			return true;
+		}
+
+		// Same steps as BVH8_CPU::BuildHQ up to the conversion
+		bvh.BuildHQ(Slice(vertices), indices.data(), static_cast<uint32_t>(indices.size() / 3));
+		bvh.CombineLeafs(LEAF_SIZE);
+		bvh.SplitLeafs(LEAF_SIZE);
+
+		Save(path, bvh);
+		return false;
+	}
+}
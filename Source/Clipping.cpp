@@ -0,0 +1,73 @@
+#include "Clipping.hpp"
+
+// Signed distance to a CLIP_GEOMETRY plane, >= 0 is inside
+static float PlaneDistance(const float4& p, uint32_t plane)
+{
+	switch (plane)
+	{
+	case CLIP_NEAR: return p.z;
+	case CLIP_GUARD_LEFT: return GUARD_BAND * p.w + p.x;
+	case CLIP_GUARD_RIGHT: return GUARD_BAND * p.w - p.x;
+	case CLIP_GUARD_BOTTOM: return GUARD_BAND * p.w + p.y;
+	case CLIP_GUARD_TOP: return GUARD_BAND * p.w - p.y;
+	}
+	return 0.f;
+}
+
+static ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t)
+{
+	ClipVertex v;
+	v.position = { a.position.x + (b.position.x - a.position.x) * t, a.position.y + (b.position.y - a.position.y) * t,
+		a.position.z + (b.position.z - a.position.z) * t, a.position.w + (b.position.w - a.position.w) * t };
+	v.uv = a.uv + (b.uv - a.uv) * t;
+	return v;
+}
+
+int ClipTriangle(const ClipVertex in[3], uint32_t planes, ClipVertex out[MAX_CLIPPED_VERTICES])
+{
+	ClipVertex buffer[MAX_CLIPPED_VERTICES];
+	ClipVertex* source = buffer;
+	ClipVertex* target = out;
+	int count = 3;
+	for (int i = 0; i < 3; i++) source[i] = in[i];
+
+	for (uint32_t plane : { CLIP_NEAR, CLIP_GUARD_LEFT, CLIP_GUARD_RIGHT, CLIP_GUARD_BOTTOM, CLIP_GUARD_TOP })
+	{
+		if (!(planes & plane)) continue;
+
+		// Keep what is inside, an edge that crosses the plane contributes the crossing. A convex
+		// polygon gains at most one vertex, the bounds check is for rounding gone wrong
+		int kept = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const ClipVertex& a = source[i];
+			const ClipVertex& b = source[(i + 1) % count];
+			float da = PlaneDistance(a.position, plane), db = PlaneDistance(b.position, plane);
+
+			if (da >= 0.f && kept < MAX_CLIPPED_VERTICES) target[kept++] = a;
+			if ((da >= 0.f) != (db >= 0.f) && kept < MAX_CLIPPED_VERTICES) target[kept++] = Lerp(a, b, da / (da - db));
+		}
+
+		count = kept;
+		std::swap(source, target);
+		if (count < 3) return 0;
+	}
+
+	if (source != out)
+	{
+		for (int i = 0; i < count; i++) out[i] = source[i];
+	}
+	return count;
+}
+
+uint32_t ComputeBoxClipCode(const float3& boundsMin, const float3& boundsMax, const mat4& MV, const mat4& proj)
+{
+	uint32_t code = ~0u;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float4 p = { corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z, 1.f };
+		float4 c = (p * MV) * proj;
+		code &= ComputeClipCode(c.x, c.y, c.z, c.w);
+	}
+	return code;
+}
@@ -0,0 +1,78 @@
+#include "CpuFeatures.hpp"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static void Cpuid(int out[4], int leaf, int subLeaf)
+{
+	__cpuidex(out, leaf, subLeaf);
+}
+
+static uint64_t Xgetbv()
+{
+	return _xgetbv(0);
+}
+#else
+#include <cpuid.h>
+
+static void Cpuid(int out[4], int leaf, int subLeaf)
+{
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subLeaf, a, b, c, d);
+	out[0] = a; out[1] = b; out[2] = c; out[3] = d;
+}
+
+static uint64_t Xgetbv()
+{
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+
+static CpuFeatures DetectCpuFeatures()
+{
+	CpuFeatures features;
+	int info[4];
+
+	Cpuid(info, 0, 0);
+	int maxLeaf = info[0];
+
+	Cpuid(info, 1, 0);
+	bool osxsave = (info[2] >> 27) & 1;
+	bool avx = (info[2] >> 28) & 1;
+	bool fma = (info[2] >> 12) & 1;
+
+	// The OS has to save the YMM (and for AVX-512 the ZMM / opmask) registers on context switches
+	uint64_t xcr0 = osxsave ? Xgetbv() : 0;
+	bool osAvx = (xcr0 & 0x6) == 0x6;
+	bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+	features.avx = avx && osAvx;
+	features.fma = fma && osAvx;
+
+	if (maxLeaf >= 7)
+	{
+		Cpuid(info, 7, 0);
+		features.avx2 = ((info[1] >> 5) & 1) && osAvx;
+		features.avx512f = ((info[1] >> 16) & 1) && osAvx512;
+		features.avx512dq = ((info[1] >> 17) & 1) && osAvx512;
+		features.avx512bw = ((info[1] >> 30) & 1) && osAvx512;
+	}
+
+	return features;
+}
+#else
+static CpuFeatures DetectCpuFeatures()
+{
+	return CpuFeatures();
+}
+#endif
+
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
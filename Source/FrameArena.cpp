@@ -0,0 +1,97 @@
+#include "FrameArena.hpp"
+#include <algorithm>
+#include <new>
+
+static constexpr std::align_val_t BLOCK_ALIGNMENT{ 64 };
+
+static uint8_t* AllocateBlock(size_t size)
+{
+	return static_cast<uint8_t*>(::operator new(size, BLOCK_ALIGNMENT));
+}
+
+static void FreeBlock(uint8_t* data)
+{
+	if (data) ::operator delete(data, BLOCK_ALIGNMENT);
+}
+
+ScratchRegion::~ScratchRegion()
+{
+	FreeBlock(current.data);
+	for (Block& block : overflow) FreeBlock(block.data);
+}
+
+void* ScratchRegion::Allocate(size_t bytes, size_t alignment)
+{
+	size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+	if (current.data == nullptr || aligned + bytes > current.size)
+	{
+		// Keep the full block until Reset(), what was handed out of it stays valid
+		if (current.data) overflow.push_back(current);
+		usedBefore += offset;
+
+		current.size = std::max(current.size * 2, bytes + alignment);
+		current.data = AllocateBlock(current.size);
+		aligned = 0;
+	}
+
+	offset = aligned + bytes;
+	highWater = std::max(highWater, usedBefore + offset);
+	return current.data + aligned;
+}
+
+void ScratchRegion::Reset()
+{
+	if (!overflow.empty())
+	{
+		// One block that holds all of this frame, the next frame like it fits without chaining
+		size_t size = current.size;
+		for (Block& block : overflow)
+		{
+			size += block.size;
+			FreeBlock(block.data);
+		}
+		overflow.clear();
+
+		FreeBlock(current.data);
+		current.size = size;
+		current.data = AllocateBlock(size);
+	}
+
+	offset = 0;
+	usedBefore = 0;
+}
+
+void ScratchRegion::Reserve(size_t bytes)
+{
+	Reset();
+	if (current.size >= bytes) return;
+
+	FreeBlock(current.data);
+	current.size = bytes;
+	current.data = AllocateBlock(bytes);
+}
+
+size_t ScratchRegion::GetCapacity() const
+{
+	size_t capacity = current.size;
+	for (const Block& block : overflow) capacity += block.size;
+	return capacity;
+}
+
+FrameArena::FrameArena(uint32_t threadCount, size_t initialBytesPerThread) : regions(threadCount)
+{
+	// Allocating the first block up front keeps the first frame off the heap as well
+	for (ScratchRegion& region : regions) region.Reserve(initialBytesPerThread);
+}
+
+void FrameArena::Reset()
+{
+	for (ScratchRegion& region : regions) region.Reset();
+}
+
+size_t FrameArena::GetHighWater() const
+{
+	size_t bytes = 0;
+	for (const ScratchRegion& region : regions) bytes += region.GetHighWater();
+	return bytes;
+}
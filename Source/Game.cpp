@@ -4,35 +4,61 @@ void Game::Init()
 {
 	lights.push_back(new PointLight()); 
 
-	testCharacter = new Model("Assets/Snake/Source/Old_Snake.obj");
-	models.push_back(testCharacter);
-
-	testFloor = new Model("Assets/Floor/Floor.obj");
-	models.push_back(testFloor);
+	// Parsed, decoded and built on the loader threads, the first frames render without them
+	// Streamed textures change size, only the others are packed into a texture array
+	assets = new AssetLoader(loaderThreadCount, compressTextures, textureBudget == 0);
+	if (textureBudget > 0) textureStreamer = new TextureStreamer(assets, textureBudget);
+	LoadModel("Assets/Snake/source/Old_Snake.obj", &testCharacter);
+	LoadModel("Assets/Floor/Floor.obj", &testFloor);
 
 	previousTime = std::chrono::high_resolution_clock::now();
 
-	std::wstring title = L"Renderer";
-	createWindow(SCREEN_WIDTH, SCREEN_HEIGHT, title.c_str());
+	platform->OpenWindow(SCREEN_WIDTH, SCREEN_HEIGHT, title);
 
 	// Init framebuffer and depth buffer
 	depthBuffer = new float[SCREEN_WIDTH * SCREEN_HEIGHT];
 	framebuffer = new uint32_t[SCREEN_WIDTH * SCREEN_HEIGHT];
-	ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
-	bitmapInfo.bmiHeader.biSize = sizeof(bitmapInfo.bmiHeader);
-	bitmapInfo.bmiHeader.biWidth = SCREEN_WIDTH;
-	bitmapInfo.bmiHeader.biHeight = -SCREEN_HEIGHT; // top-down
-	bitmapInfo.bmiHeader.biPlanes = 1;
-	bitmapInfo.bmiHeader.biBitCount = 32;
-	bitmapInfo.bmiHeader.biCompression = BI_RGB;
-
-	for (int i = 0; i < models.size(); ++i)
+
+	jobs = new JobSystem(threadCount);
+	threadRays.resize(jobs->GetThreadCount());
+	frameArena = new FrameArena(jobs->GetThreadCount(), FRAME_ARENA_BYTES_PER_THREAD);
+	traceTileSize = std::max(1, traceTileSize);
+	rasterizer = new Rasterizer(framebuffer, depthBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, jobs);
+	geometry = new GeometryPipeline(rasterizer, jobs, frameArena);
+	if (rasterKernel != RasterKernel::Auto) rasterizer->SetKernel(rasterKernel);
+	rasterizer->SetTextureFilter(textureFilter);
+	Logger::Log(std::string("Raster kernel: ") + Rasterizer::GetKernelName(rasterizer->GetKernel()));
+}
+
+void Game::LoadModel(const char* filePath, Model** target)
+{
+	pendingModels.push_back({ assets->LoadModel(filePath), target });
+}
+
+void Game::AddLoadedModels()
+{
+	auto loaded = [](const PendingModel& pending) { return pending.handle.IsReady(); };
+	for (const PendingModel& pending : pendingModels)
 	{
-		blases.push_back(tinybvh::BLASInstance(i));
-		bvh.push_back(models[i]->modelBVH);
+		if (!loaded(pending)) continue;
+
+		// The loader logged why, the scene goes on without it
+		Model* model = pending.handle.Get();
+		if (!model) continue;
+
+		*pending.target = model;
+		scene.AddInstance(static_cast<uint32_t>(models.size()), model->modelBVH, model->packetBVH);
+		models.push_back(model);
+		if (textureStreamer) textureStreamer->AddModel(model);
 	}
 
-	tlas.Build(blases.data(), static_cast<uint32_t>(blases.size()), bvh.data(), static_cast<uint32_t>(bvh.size()));
+	pendingModels.erase(std::remove_if(pendingModels.begin(), pendingModels.end(), loaded), pendingModels.end());
+}
+
+void Game::WaitForAssets()
+{
+	for (const PendingModel& pending : pendingModels) pending.handle.Wait();
+	AddLoadedModels();
 }
 
 void Game::Update()
@@ -58,54 +84,66 @@ void Game::Update()
 	HandleInput();
 }
 
-bool Game::createWindow(int widht, int height, const wchar_t* title)
+void Game::OnKeyDown(Key key)
 {
-	HINSTANCE instance = GetModuleHandleA(0);
-
-	WNDCLASSW wc = {};
-	wc.hInstance = instance;
-	wc.hIcon = LoadIcon(instance, IDI_APPLICATION);
-	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-	wc.lpszClassName = title;
-	wc.lpfnWndProc = WindowProc;
-
-	if (!RegisterClassW(&wc)) return false;
-
-	int dwStyle = WS_OVERLAPPEDWINDOW;
-
-	window = CreateWindowExW(0, title, title, dwStyle, 100, 100, widht, height, NULL, NULL, instance, NULL);
-
-	if (!window) return false;
-
-	ShowWindow(window, SW_SHOW);
-	return true;
+	switch (key)
+	{
+	case Key::ToggleRenderMode:
+	{
+		if (gameState.rasterized == true)
+		{
+			gameState.rasterized = false;
+			gameState.raytraced = true;
+		}
+		else if (gameState.raytraced == true)
+		{
+			gameState.rasterized = true;
+			gameState.raytraced = false;
+		}
+		break;
+	}
+	case Key::Forward:
+		input.moveForward = true;
+		break;
+	case Key::Backward:
+		input.moveBackward = true;
+		break;
+	case Key::Left:
+		input.moveLeft = true;
+		break;
+	case Key::Right:
+		input.moveRight = true;
+		break;
+	default:
+		break;
+	}
 }
 
-void Game::UpdateWindow()
+void Game::OnKeyUp(Key key)
 {
-	MSG msg;
-
-	while (PeekMessage(&msg, window, 0, 0, PM_REMOVE))
+	switch (key)
 	{
-		if (msg.message == WM_QUIT)
-			isRunning = false;
-
-		TranslateMessage(&msg);
-		DispatchMessageA(&msg);
+	case Key::Forward:
+		input.moveForward = false;
+		break;
+	case Key::Backward:
+		input.moveBackward = false;
+		break;
+	case Key::Left:
+		input.moveLeft = false;
+		break;
+	case Key::Right:
+		input.moveRight = false;
+		break;
+	default:
+		break;
 	}
 }
 
 void Game::Clear(uint32_t color)
 {
-	for (int x = 0; x < SCREEN_WIDTH; x++)
-	{
-		for (int y = 0; y < SCREEN_HEIGHT; y++)
-		{
-			int index = y * SCREEN_WIDTH + x;
-			depthBuffer[index] = 1.f;
-			framebuffer[index] = color;
-		}
-	}
+	std::fill(framebuffer, framebuffer + SCREEN_WIDTH * SCREEN_HEIGHT, color);
+	rasterizer->ClearDepth(1.f);
 }
 
 void Game::Plot(uint32_t color, int pX, int pY)
@@ -146,254 +184,74 @@ void Game::TriangleWireframe(uint32_t color, float x1, float y1, float x2, float
 	Line(color, x1, y1, x3, y3);
 }
 
-std::vector<Triangle> Game::CullBackFaces(std::vector<float3>& viewVertices, std::vector<Triangle>& triangles)
+// TODO: arguments on this functions are not needed since I pass model pointer
+void Game::RenderObject(Model* targetModel, uint32_t color, std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, std::span<const Triangle> triangles, const mat4& MV, const mat4& proj)
 {
-	std::vector<Triangle> result;
-	for (const auto& tri : triangles)
-	{
-		if (BackFacing(tri, viewVertices))
-			result.push_back(tri);
-	}
-	return result;
+	// Queued, the geometry pipeline does the work for all models at once when the frame is rasterized
+	geometry->AddDraw(targetModel->mesh, positions, uvs, triangles, targetModel->mesh.materialRanges, MV, proj);
 }
 
-bool Game::BackFacing(const Triangle& triangle, std::vector<float3>& viewVerts)
-{
-	const float3& p0 = viewVerts[triangle.indices[0]];
-	const float3& p1 = viewVerts[triangle.indices[1]];
-	const float3& p2 = viewVerts[triangle.indices[2]];
-
-	float3 edge1 = p1 - p0;
-	float3 edge2 = p2 - p0;
-	float3 normal = normalize(Cross(edge1, edge2));
-
-	// Direction from camera (0,0,0 in view space) to triangle
-	float3 toCamera = normalize(float3{ -p0.x, -p0.y, -p0.z }); // View space eye is at origin
-
-	// Backface if facing away from camera
-	return Dot(normal, toCamera) < 0.f;
+inline float dot(const tinybvh::bvhvec3& a, const tinybvh::bvhvec3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
-void Game::PlotTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const Mesh& mesh, const int matIndex)
+void Game::TraceTile(int tileX, int tileY, uint64_t& rayCount)
 {
-	// Bounding box
-	int minX = std::max(0, (int)std::floor(std::min({ v0.position.x, v1.position.x, v2.position.x })));
-	int maxX = std::min(SCREEN_WIDTH - 1, (int)std::ceil(std::max({ v0.position.x, v1.position.x, v2.position.x })));
-	int minY = std::max(0, (int)std::floor(std::min({ v0.position.y, v1.position.y, v2.position.y })));
-	int maxY = std::min(SCREEN_HEIGHT - 1, (int)std::ceil(std::max({ v0.position.y, v1.position.y, v2.position.y })));
+	int minX = tileX * traceTileSize, maxX = std::min(minX + traceTileSize, SCREEN_WIDTH);
+	int minY = tileY * traceTileSize, maxY = std::min(minY + traceTileSize, SCREEN_HEIGHT);
 
-	float2 p0 = { v0.position.x, v0.position.y };
-	float2 p1 = { v1.position.x, v1.position.y };
-	float2 p2 = { v2.position.x, v2.position.y };
-
-	// Triangle area (for barycentric)
-	float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
-	if (area == 0.0f) return; // Degenerate
-
-	for (int y = minY; y <= maxY; ++y)
+	for (int y = minY; y < maxY; y++)
 	{
-		for (int x = minX; x <= maxX; ++x)
+		for (int x = minX; x < maxX; x++)
 		{
-			float2 p = { x + 0.5f, y + 0.5f };
-
-			// Compute barycentric weights
-			float w0 = ((p1.x - p.x) * (p2.y - p.y) - (p2.x - p.x) * (p1.y - p.y)) / area;
-			float w1 = ((p2.x - p.x) * (p0.y - p.y) - (p0.x - p.x) * (p2.y - p.y)) / area;
-			float w2 = 1.0f - w0 - w1;
-
-			if (w0 < 0 || w1 < 0 || w2 < 0) continue; // Outside
-
-			// Interpolate depth (perspective correct)
-			float invZ = 1.0f / v0.position.z * w0 + 1.0f / v1.position.z * w1 + 1.0f / v2.position.z * w2;
-			float z = 1.0f / invZ;
-
-			int index = y * SCREEN_WIDTH + x;
-			if (z >= depthBuffer[index]) continue;
-
-			// We store some precaculated values for the affine inside vertices (invW and uvDivW)
-			float invW = w0 * v0.invW + w1 * v1.invW + w2 * v2.invW;
-
-			float u = (w0 * v0.uvDivW.x + w1 * v1.uvDivW.x + w2 * v2.uvDivW.x) / invW;
-			float v = (w0 * v0.uvDivW.y + w1 * v1.uvDivW.y + w2 * v2.uvDivW.y) / invW;
-
-			u = std::clamp(u, 0.0f, 1.f);
-			v = std::clamp(v, 0.0f, 1.f);
-
-			// Here we store the texture the triangle has
-			Texture tex = mesh.textures[matIndex];
-
-			// Sample texture
-			int texX = int(u * tex.GetWidth());
-			int texY = int(v * tex.GetHeight());
-			
-			// Clamp coordinates to valid range
-			texX = std::clamp(texX, 0, tex.GetWidth() - 1);
-			texY = std::clamp(texY, 0, tex.GetHeight() - 1);
-			
-			// Diffuse
-			
-			uint8_t r = tex.GetTexel(texX, texY, 0); // Red channel
-			uint8_t g = tex.GetTexel(texX, texY, 1); // Green channel
-			uint8_t b = tex.GetTexel(texX, texY, 2); // Blue channel
-			
-
-			// UV
-			/*
-			uint8_t r = uint8_t(u * 255.0f);
-			uint8_t g = uint8_t(v * 255.0f);
-			uint8_t b = 0; // You can also set b = 255 - g for gradient effect
-			*/
-
-			// Write to framebuffer
-			depthBuffer[index] = z;
-			Plot(MakeColor(r, g, b, 255), x, y);
+			tinybvh::Ray tracedRay = mainCam.GetPrimaryRay(x, y);
+			float3 trace = Trace(tracedRay, rayCount);
+			uint32_t pixel = MakeColor(int(trace.x), int(trace.y), int(trace.z), 255);
+			Plot(pixel, x, y);
 		}
 	}
 }
 
-// TODO: arguments on this functions are not needed since I pass model pointer
-void Game::RenderObject(Model* targetModel, uint32_t color, std::vector<Vertex>& vertices, std::vector<Triangle>& triangles, const mat4& MV, const mat4& proj)
+// Packet of the 16x16 pixels starting at pX, pY. Primary rays share the camera origin,
+// which Intersect256Rays relies on. Its packets are 4x4 blocks of 4x4 rays, so that rays
+// 0, 51, 204 and 255 are the corners it builds the packet frustum from.
+void Game::TracePacket(int pX, int pY, uint64_t& rayCount)
 {
-	// TODO: chatgpt id this shit look into it
-	auto interpolate = [](const Vertex& a, const Vertex& b, float t) -> Vertex {
-		Vertex v;
-		v.position = a.position + (b.position - a.position) * t;
-		v.uv = a.uv + (b.uv - a.uv) * t;
-		return v;
-		};
-
-	std::vector<Vertex> viewVerts;
-	viewVerts.reserve(vertices.size());
-	for (const auto& v : vertices)
-	{
-		float4 viewPos = v.pos4() * MV;
-		Vertex out = v;
-		out.position = { viewPos.x, viewPos.y, viewPos.z };
-		viewVerts.push_back(out);
-	}
+	tinybvh::Ray packet[256];
 
-	std::vector<Triangle> clippedTris;
-	std::vector<Vertex> clippedVerts;
-	for (auto& triangle : triangles)
+	for (int i = 0; i < 256; i++)
 	{
-		const Vertex& v0 = viewVerts[triangle.indices[0]];
-		const Vertex& v1 = viewVerts[triangle.indices[1]];
-		const Vertex& v2 = viewVerts[triangle.indices[2]];
-
-		float z0 = v0.position.z;
-		float z1 = v1.position.z;
-		float z2 = v2.position.z;
-
-		std::vector<std::pair<Vertex, float>> inside;
-		std::vector<std::pair<Vertex, float>> outside;
-
-		if (z0 >= mainCam.zNear) inside.push_back({ v0, z0 }); else outside.push_back({ v0, z0 });
-		if (z1 >= mainCam.zNear) inside.push_back({ v1, z1 }); else outside.push_back({ v1, z1 });
-		if (z2 >= mainCam.zNear) inside.push_back({ v2, z2 }); else outside.push_back({ v2, z2 });
-
-		if (inside.empty()) continue;
-
-		if (outside.empty())
-		{
-			size_t base = clippedVerts.size();
-			clippedVerts.push_back(v0);
-			clippedVerts.push_back(v1);
-			clippedVerts.push_back(v2);
-			Triangle t1;
-			t1.materialIndex = triangle.materialIndex;
-			t1.indices[0] = base + 0;
-			t1.indices[2] = base + 1;
-			t1.indices[1] = base + 2;
-			clippedTris.push_back(t1);
-		}
-		else if (inside.size() == 1)
-		{
-			Vertex A = inside[0].first;
-			Vertex B = interpolate(A, outside[0].first, (mainCam.zNear - inside[0].second) / (outside[0].second - inside[0].second));
-			Vertex C = interpolate(A, outside[1].first, (mainCam.zNear - inside[0].second) / (outside[1].second - inside[0].second));
-			size_t base = clippedVerts.size();
-			clippedVerts.push_back(A);
-			clippedVerts.push_back(B);
-			clippedVerts.push_back(C);
-			Triangle t1;
-			t1.materialIndex = triangle.materialIndex;
-			t1.indices[0] = base + 0;
-			t1.indices[2] = base + 1;
-			t1.indices[1] = base + 2;
-			clippedTris.push_back(t1);
-		}
-		else if (inside.size() == 2)
-		{
-			Vertex A = inside[0].first;
-			Vertex B = inside[1].first;
-			Vertex C = interpolate(A, outside[0].first, (mainCam.zNear - inside[0].second) / (outside[0].second - inside[0].second));
-			Vertex D = interpolate(B, outside[0].first, (mainCam.zNear - inside[1].second) / (outside[0].second - inside[1].second));
-			size_t base = clippedVerts.size();
-			clippedVerts.push_back(A);
-			clippedVerts.push_back(B);
-			clippedVerts.push_back(C);
-			clippedVerts.push_back(D);
-			Triangle t1;
-			Triangle t2;
-			t1.materialIndex = triangle.materialIndex;
-			t2.materialIndex = triangle.materialIndex;
-			t1.indices[0] = base + 0;
-			t1.indices[2] = base + 1;
-			t1.indices[1] = base + 2;
-			clippedTris.push_back(t1);
-			t2.indices[0] = base + 0;
-			t2.indices[2] = base + 3;
-			t2.indices[1] = base + 2;
-			clippedTris.push_back(t2);
-		}
+		int x = (i & 3) | (((i >> 4) & 3) << 2);
+		int y = ((i >> 2) & 3) | (((i >> 6) & 3) << 2);
+		packet[i] = mainCam.GetPrimaryRay(pX + x, pY + y);
 	}
 
-	std::vector<float3> viewPositions;
-	viewPositions.reserve(clippedVerts.size());
-	for (const auto& v : clippedVerts)
-		viewPositions.push_back(v.position);
-
-	auto culledTriangles = CullBackFaces(viewPositions, clippedTris);
+	scene.Intersect256Rays(packet);
+	rayCount += 256;
 
-	std::vector<Vertex> projected(clippedVerts.size());
-	for (size_t i = 0; i < clippedVerts.size(); ++i)
+	for (int i = 0; i < 256; i++)
 	{
-		float4 c = clippedVerts[i].pos4() * proj;
-		if (std::abs(c.w) < 1e-5f) continue;
+		int x = pX + ((i & 3) | (((i >> 4) & 3) << 2));
+		int y = pY + (((i >> 2) & 3) | (((i >> 6) & 3) << 2));
+		if (x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) continue;
 
-		float ndcX = c.x / c.w;
-		float ndcY = c.y / c.w;
-		float ndcZ = c.z / c.w;
-
-		float screenX = (ndcX + 1.0f) * 0.5f * SCREEN_WIDTH;
-		float screenY = (1.0f - (ndcY + 1.0f) * 0.5f) * SCREEN_HEIGHT;
-
-		Vertex v;
-		v.position = { screenX, screenY, ndcZ }; // keep ndcZ for depth buffer
-		v.invW = 1.0f / c.w;
-		v.uvDivW = clippedVerts[i].uv * v.invW;
-
-		projected[i] = v;
-	}
-
-	for (const auto& tri : culledTriangles)
-	{
-		const Vertex& v0 = projected[tri.indices[0]];
-		const Vertex& v1 = projected[tri.indices[1]];
-		const Vertex& v2 = projected[tri.indices[2]];
-		int materialIndex = tri.materialIndex;
-		PlotTriangle(v0, v1, v2, targetModel->mesh, materialIndex);
+		float3 shade = Shade(packet[i], rayCount);
+		Plot(MakeColor(int(shade.x), int(shade.y), int(shade.z), 255), x, y);
 	}
 }
 
-inline float dot(const tinybvh::bvhvec3& a, const tinybvh::bvhvec3& b) {
-	return a.x * b.x + a.y * b.y + a.z * b.z;
+// Called from all render threads at once, the TLAS is only read
+float3 Game::Trace(tinybvh::Ray& ray, uint64_t& rayCount)
+{
+	scene.GetTLAS().IntersectTLAS(ray);
+	rayCount++;
+
+	return Shade(ray, rayCount);
 }
 
-float3 Game::Trace(tinybvh::Ray& ray)
+// Shadow rays are incoherent, they always take the single ray path
+float3 Game::Shade(const tinybvh::Ray& ray, uint64_t& rayCount)
 {
-	tlas.IntersectTLAS(ray);
-
 	if (ray.hit.t >= BVH_FAR) return float3{ 0.f, 255.f, 0.f };
 
 	tinybvh::bvhvec3 I = ray.IntersectionPoint();
@@ -402,17 +260,39 @@ float3 Game::Trace(tinybvh::Ray& ray)
 	{
 		tinybvh::bvhvec3 L = tinybvh::bvhvec3(lights[0]->position.x, lights[0]->position.y, lights[0]->position.z) - I;
 		
-		float distance = std::sqrtf(L.x * L.x + L.y * L.y + L.z * L.z);
+		float distance = sqrtf(L.x * L.x + L.y * L.y + L.z * L.z);
 
 		tinybvh::bvhvec3 dir = L * (1.0f / distance); // Normalize L
 
 		tinybvh::Ray shadowRay(I + dir * EPSILON, dir, distance - EPSILON);
 
-		if (tlas.IsOccluded(shadowRay)) return float3{ 0.f, 0.f, 0.f };
-		else return float3{ 255.f, 0.f, 0.f };
+		rayCount++;
+		if (scene.GetTLAS().IsOccluded(shadowRay)) return float3{ 0.f, 0.f, 0.f };
+
+		uint32_t color = SampleHit(ray.hit);
+		return float3{ float((color >> 16) & 0xFF), float((color >> 8) & 0xFF), float(color & 0xFF) };
 	}
 }
 
+// Texture of the hit triangle at the hit, bilinear from the finest resident level (rays
+// have no footprint) with the addressing of its material, the same sampler the rasterizer uses
+uint32_t Game::SampleHit(const tinybvh::Intersection& hit) const
+{
+	const Mesh& mesh = models[scene.GetInstances()[hit.inst].blasIdx]->mesh;
+	const Triangle& triangle = mesh.triangle[hit.prim];
+
+	const float2& uv0 = mesh.uvs[triangle.indices[0]];
+	const float2& uv1 = mesh.uvs[triangle.indices[1]];
+	const float2& uv2 = mesh.uvs[triangle.indices[2]];
+	float w = 1.f - hit.u - hit.v;
+	float u = uv0.x * w + uv1.x * hit.u + uv2.x * hit.v;
+	float v = uv0.y * w + uv1.y * hit.u + uv2.y * hit.v;
+
+	TextureSampler tex = mesh.GetSampler(triangle.materialIndex);
+	if (tex.feedback) tex.feedback->Record(0);
+	return tex.SampleBilinear(tex.Address(u), tex.Address(v), tex.minLevel);
+}
+
 void Game::IntersectTri(Ray& ray, const Tri& tri)
 {
 	const float3 edge1 = tri.vertex1 - tri.vertex0;
@@ -433,69 +313,101 @@ void Game::IntersectTri(Ray& ray, const Tri& tri)
 
 void Game::Render()
 {
-	UpdateWindow();
-	
+	// Keeps the capacity of raysPerThread
+	std::vector<uint64_t> raysPerThread = std::move(stats.raysPerThread);
+	stats = RenderStats();
+	stats.raysPerThread = std::move(raysPerThread);
+	uint64_t allocationsBefore = AllocationCounter::GetCount();
+
 	Clear(0x00000000);
+	frameArena->Reset();
+
+	if (!pendingModels.empty()) AddLoadedModels();
+	if (textureStreamer) stats.textureStreaming = textureStreamer->Update();
 
 	mainCam.BuildViewPlane();
 
 	mat4 model2 = (mat::Translate(0.f, -11.f, 20.f) + mat::Scale(0.001f, 0.001f, 0.001f));
 	mat4 model = (mat::Translate(0.f, -10.f, 20.f) + mat::Scale(0.001f, 0.001f, 0.001f)) * mat::Rotate(0.0f, 1.f, 0.0f, rotationIncrement);
 	mat4 view = mat::LookAt(mainCam.eye, mainCam.eye + mainCam.target, mainCam.up);
-	mat4 proj = mat::Perspective(mainCam.fovRad, mainCam.aspect, 1.0f, 500.0f);
+	mat4 proj = mat::Perspective(mainCam.fovRad, mainCam.aspect, mainCam.zNear, mainCam.zFar);
 
 	mat4 MV = view * model;
 	mat4 MV2 = view * model2;
 	mat4 MVP = proj * view * model;
 
-	for (int m = 0; m < models.size(); ++m)
-	{
-		for (int i = 0; i < 4; i++)
-		{
-			for (int j = 0; j < 4; j++)
-			{
-				if (m == 0 )
-					blases[0].transform[i * 4 + j] = model.m[j][i];
-				else if (m == 1)
-					blases[1].transform[i * 4 + j] = model2.m[j][i];
-			}
-		}
-	}
-
-	tlas.Build(blases.data(), static_cast<uint32_t>(blases.size()), bvh.data(), static_cast<uint32_t>(bvh.size()));
+	// Only marks what moved, the TLAS itself is brought up to date when rays get traced.
+	// Models are in the order they finished loading, the snake spins and everything else stays put
+	for (uint32_t i = 0; i < models.size(); i++) scene.SetTransform(i, models[i] == testCharacter ? model : model2);
 
 	if (gameState.rasterized == true) 
 	{
+		rasterizer->BeginFrame(frameArena->GetScratch(0));
+		geometry->BeginFrame();
+
 		for (int i = 0; i < models.size(); ++i)
 		{
-			if (i == 0)
-				RenderObject(models[i], 0xFFFFFFFF, models[i]->mesh.vertices, models[i]->mesh.triangle, MV, proj);
+			if (models[i] == testCharacter)
+				RenderObject(models[i], 0xFFFFFFFF, models[i]->mesh.positions, models[i]->mesh.uvs, models[i]->mesh.triangle, MV, proj);
 			else
-				RenderObject(models[i], 0xFFFFFFFF, models[i]->mesh.vertices, models[i]->mesh.triangle, MV2, proj);
+				RenderObject(models[i], 0xFFFFFFFF, models[i]->mesh.positions, models[i]->mesh.uvs, models[i]->mesh.triangle, MV2, proj);
 		}
+
+		GeometryStats geometryStats = geometry->Run();
+		stats.trianglesSubmitted = geometryStats.trianglesSubmitted;
+		stats.trianglesRasterized = geometryStats.trianglesRasterized;
+		stats.trianglesClipped = geometryStats.trianglesClipped;
+		stats.modelsCulled = geometryStats.modelsCulled;
+		stats.verticesProjected = geometryStats.verticesProjected;
+
+		rasterizer->Flush();
+		stats.occlusion = rasterizer->GetOcclusionStats();
 	}
-	else if (gameState.raytraced == true)
+	else if (gameState.raytraced == true && scene.GetInstanceCount() > 0) // No TLAS until the first model is loaded
 	{
-		for (int y = 0; y < SCREEN_HEIGHT; y++)
+		int tilesX = (SCREEN_WIDTH + traceTileSize - 1) / traceTileSize;
+		int tilesY = (SCREEN_HEIGHT + traceTileSize - 1) / traceTileSize;
+
+		stats.tlasUpdate = scene.Update();
+
+		for (ThreadRayCount& count : threadRays) count.rays = 0;
+
+		if (gameState.packets)
+		{
+			// Packets at the screen border still trace all 256 rays, only the pixels on screen get shaded
+			int packetsX = (SCREEN_WIDTH + 15) / 16, packetsY = (SCREEN_HEIGHT + 15) / 16;
+			jobs->ParallelFor(static_cast<uint32_t>(packetsX * packetsY), [&](uint32_t packet, uint32_t thread)
+				{
+					TracePacket((packet % packetsX) * 16, (packet / packetsX) * 16, threadRays[thread].rays);
+				});
+		}
+		else
 		{
-			for (int x = 0; x < SCREEN_WIDTH; x++)
-			{
-				tinybvh::Ray tracedRay = mainCam.GetPrimaryRay(x, y);
-				float3 trace = Trace(tracedRay);
-				uint32_t pixel = MakeColor(int(trace.x), int(trace.y), int(trace.z), 255);
-				Plot(pixel, x, y);
-			}
+			jobs->ParallelFor(static_cast<uint32_t>(tilesX * tilesY), [&](uint32_t tile, uint32_t thread)
+				{
+					TraceTile(tile % tilesX, tile / tilesX, threadRays[thread].rays);
+				});
+		}
+
+		stats.raysPerThread.resize(threadRays.size());
+		for (size_t i = 0; i < threadRays.size(); i++)
+		{
+			stats.raysPerThread[i] = threadRays[i].rays;
+			stats.raysTraced += threadRays[i].rays;
 		}
 	}
 
 	//mainCam.BuildViewPlane();
 
-	InvalidateRect(window, nullptr, FALSE);
+	// Presenting is the platform's business, frame dumps allocate for their file names
+	stats.heapAllocations = AllocationCounter::GetCount() - allocationsBefore;
+
+	platform->Present(framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT);
 }
 
 void Game::HandleEvents()
 {
-
+	platform->PumpEvents(this);
 }
 
 void Game::HandleInput()
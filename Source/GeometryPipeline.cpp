@@ -0,0 +1,181 @@
+#include "GeometryPipeline.hpp"
+#include <algorithm>
+#include <new>
+
+GeometryPipeline::GeometryPipeline(Rasterizer* rasterizer, JobSystem* jobs, FrameArena* frameArena)
+	: rasterizer(rasterizer), jobs(jobs), frameArena(frameArena)
+{
+}
+
+void GeometryPipeline::BeginFrame()
+{
+	draws.clear();
+	batches = {};
+	nextToBin = 0;
+	stats = GeometryStats();
+}
+
+void GeometryPipeline::AddDraw(const Mesh& mesh, std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, std::span<const Triangle> triangles,
+	std::span<const MaterialRange> materials, const mat4& MV, const mat4& proj)
+{
+	stats.trianglesSubmitted += triangles.size();
+
+	// A model whose bounding box is outside one frustum plane is skipped before any vertex work
+	if (ComputeBoxClipCode(mesh.boundsMin, mesh.boundsMax, MV, proj) & CLIP_FRUSTUM)
+	{
+		stats.modelsCulled++;
+		return;
+	}
+
+	Draw& draw = draws.emplace_back();
+	draw.mesh = &mesh;
+	draw.positions = positions;
+	draw.uvs = uvs;
+	draw.triangles = triangles;
+	draw.materials = materials;
+	draw.MV = MV;
+	draw.proj = proj;
+
+	// Every mesh vertex is transformed and projected once, so triangles sharing a vertex share its result
+	draw.transformed.Allocate(frameArena->GetScratch(0), positions.size());
+	draw.transformed.count = positions.size();
+	stats.verticesProjected += positions.size();
+}
+
+GeometryStats GeometryPipeline::Run()
+{
+	uint32_t batchCount = 0;
+	vertexChunkCount = 0;
+	for (Draw& draw : draws)
+	{
+		draw.firstVertexChunk = vertexChunkCount;
+		draw.firstBatch = batchCount;
+		vertexChunkCount += static_cast<uint32_t>((draw.positions.size() + VERTEX_BATCH_SIZE - 1) / VERTEX_BATCH_SIZE);
+		for (const MaterialRange& range : draw.materials)
+			batchCount += (range.triangleCount + GEOMETRY_BATCH_SIZE - 1) / GEOMETRY_BATCH_SIZE;
+	}
+
+	// A batch never crosses into the next material
+	batches = frameArena->GetScratch(0).AllocateArray<Batch>(batchCount);
+	for (uint32_t d = 0; d < draws.size(); d++)
+	{
+		uint32_t b = draws[d].firstBatch;
+		for (const MaterialRange& range : draws[d].materials)
+		{
+			for (uint32_t first = 0; first < range.triangleCount; first += GEOMETRY_BATCH_SIZE, b++)
+			{
+				Batch* batch = ::new (static_cast<void*>(&batches[b])) Batch();
+				batch->draw = d;
+				batch->firstTriangle = range.firstTriangle + first;
+				batch->triangleCount = std::min<uint32_t>(GEOMETRY_BATCH_SIZE, range.triangleCount - first);
+				batch->materialIndex = range.materialIndex;
+			}
+		}
+	}
+
+	// Batches can reference any vertex of their draw, so all vertices come first
+	jobs->ParallelFor(vertexChunkCount, [this](uint32_t chunk, uint32_t)
+		{
+			TransformChunk(chunk);
+		});
+
+	jobs->ParallelFor(batchCount, [this](uint32_t index, uint32_t threadIndex)
+		{
+			ProcessBatch(batches[index], frameArena->GetScratch(threadIndex));
+
+			// Thread 0 starts on the first batches, so the front of the order is usually
+			// finished by the time it gets here
+			if (threadIndex == 0) BinFinishedBatches();
+		});
+
+	BinFinishedBatches();
+	return stats;
+}
+
+void GeometryPipeline::TransformChunk(uint32_t chunk)
+{
+	// Last draw that starts at or before the chunk, draws without vertices start where the next one does
+	auto next = std::upper_bound(draws.begin(), draws.end(), chunk, [](uint32_t c, const Draw& draw) { return c < draw.firstVertexChunk; });
+	Draw& draw = *(next - 1);
+
+	size_t first = size_t(chunk - draw.firstVertexChunk) * VERTEX_BATCH_SIZE;
+	size_t count = std::min<size_t>(VERTEX_BATCH_SIZE, draw.positions.size() - first);
+
+	TransformedVertices slice = draw.transformed.Slice(first, count);
+	TransformVertices(draw.positions.subspan(first, count), draw.uvs.subspan(first, count), draw.MV, draw.proj,
+		rasterizer->GetWidth(), rasterizer->GetHeight(), rasterizer->GetKernel() != RasterKernel::Scalar, slice);
+}
+
+void GeometryPipeline::ProcessBatch(Batch& batch, ScratchRegion& scratch)
+{
+	const Draw& draw = draws[batch.draw];
+	const TransformedVertices& transformed = draw.transformed;
+	std::span<const Triangle> triangles = draw.triangles.subspan(batch.firstTriangle, batch.triangleCount);
+	batch.texture = draw.mesh->GetSampler(batch.materialIndex);
+
+	// Upper bound of the output from the outcodes alone, so it fits in one array
+	size_t capacity = 0;
+	for (const auto& triangle : triangles)
+	{
+		uint32_t code0 = transformed.clipCode[triangle.indices[0]], code1 = transformed.clipCode[triangle.indices[1]], code2 = transformed.clipCode[triangle.indices[2]];
+		if (code0 & code1 & code2 & CLIP_FRUSTUM) continue;
+		capacity += ((code0 | code1 | code2) & CLIP_GEOMETRY) ? MAX_CLIPPED_VERTICES - 2 : 1;
+	}
+	batch.output = scratch.AllocateArray<RasterTriangle>(capacity).data();
+
+	auto setup = [&](const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2)
+		{
+			batch.rasterized++;
+			if (rasterizer->Setup(v0, v1, v2, &batch.texture, batch.output[batch.outputCount])) batch.outputCount++;
+		};
+
+	for (const auto& triangle : triangles)
+	{
+		uint32_t i0 = triangle.indices[0], i1 = triangle.indices[1], i2 = triangle.indices[2];
+
+		// All corners outside the same plane, or facing away
+		uint32_t code0 = transformed.clipCode[i0], code1 = transformed.clipCode[i1], code2 = transformed.clipCode[i2];
+		if (code0 & code1 & code2 & CLIP_FRUSTUM) continue;
+		if (!FrontFacing(transformed.ClipPosition(i0), transformed.ClipPosition(i1), transformed.ClipPosition(i2))) continue;
+
+		// Inside the near plane and the guard band, the rasterizer clamps it to the screen
+		uint32_t crossed = (code0 | code1 | code2) & CLIP_GEOMETRY;
+		if (crossed == 0)
+		{
+			setup(transformed.GetScreenVertex(i0), transformed.GetScreenVertex(i2), transformed.GetScreenVertex(i1));
+			continue;
+		}
+
+		batch.clipped++;
+		ClipVertex corners[3] =
+		{
+			{ transformed.ClipPosition(i0), draw.uvs[i0] },
+			{ transformed.ClipPosition(i1), draw.uvs[i1] },
+			{ transformed.ClipPosition(i2), draw.uvs[i2] }
+		};
+		ClipVertex polygon[MAX_CLIPPED_VERTICES];
+		int count = ClipTriangle(corners, crossed, polygon);
+
+		ScreenVertex screen[MAX_CLIPPED_VERTICES];
+		for (int i = 0; i < count; i++) screen[i] = ProjectToScreen(polygon[i].position, polygon[i].uv, rasterizer->GetWidth(), rasterizer->GetHeight());
+		batch.clippedVertices += count;
+
+		// Fan around the first corner
+		for (int i = 1; i + 1 < count; i++) setup(screen[0], screen[i + 1], screen[i]);
+	}
+
+	batch.done.store(1, std::memory_order_release);
+}
+
+void GeometryPipeline::BinFinishedBatches()
+{
+	while (nextToBin < batches.size() && batches[nextToBin].done.load(std::memory_order_acquire))
+	{
+		const Batch& batch = batches[nextToBin++];
+		for (uint32_t i = 0; i < batch.outputCount; i++) rasterizer->Bin(&batch.output[i]);
+
+		stats.trianglesRasterized += batch.rasterized;
+		stats.trianglesClipped += batch.clipped;
+		stats.verticesProjected += batch.clippedVertices;
+	}
+}
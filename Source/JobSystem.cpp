@@ -0,0 +1,135 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+
+static uint64_t PackRange(uint32_t begin, uint32_t end) { return (uint64_t(end) << 32) | begin; }
+static uint32_t RangeBegin(uint64_t range) { return static_cast<uint32_t>(range); }
+static uint32_t RangeEnd(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	this->threadCount = std::max(1u, threadCount);
+	ranges = std::vector<WorkRange>(this->threadCount);
+
+	for (uint32_t i = 1; i < this->threadCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void JobSystem::ParallelFor(uint32_t count, const Job& job)
+{
+	if (count == 0) return;
+
+	// Not worth waking anyone up
+	if (workers.empty() || count == 1)
+	{
+		for (uint32_t i = 0; i < count; i++) job(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+
+		// Even split, the first count % threadCount threads get one more
+		uint32_t begin = 0;
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			uint32_t end = begin + count / threadCount + (i < count % threadCount ? 1 : 0);
+			ranges[i].range.store(PackRange(begin, end), std::memory_order_relaxed);
+			begin = end;
+		}
+		activeWorkers = static_cast<uint32_t>(workers.size());
+		generation++;
+	}
+	wake.notify_all();
+
+	RunItems(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return activeWorkers == 0; });
+	this->job = nullptr;
+}
+
+void JobSystem::RunItems(uint32_t threadIndex)
+{
+	uint32_t index;
+	do
+	{
+		while (PopItem(threadIndex, index))
+			(*job)(index, threadIndex);
+	} while (StealRange(threadIndex));
+}
+
+bool JobSystem::PopItem(uint32_t threadIndex, uint32_t& index)
+{
+	std::atomic<uint64_t>& own = ranges[threadIndex].range;
+	uint64_t range = own.load(std::memory_order_acquire);
+
+	while (RangeBegin(range) < RangeEnd(range))
+	{
+		if (own.compare_exchange_weak(range, PackRange(RangeBegin(range) + 1, RangeEnd(range)), std::memory_order_acq_rel))
+		{
+			index = RangeBegin(range);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Takes the back half of the first non empty range after our own and makes it ours.
+// Returns false once every range is empty.
+bool JobSystem::StealRange(uint32_t threadIndex)
+{
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		std::atomic<uint64_t>& victim = ranges[(threadIndex + i) % threadCount].range;
+		uint64_t range = victim.load(std::memory_order_acquire);
+
+		while (RangeBegin(range) < RangeEnd(range))
+		{
+			uint32_t begin = RangeBegin(range), end = RangeEnd(range);
+			uint32_t split = end - (end - begin + 1) / 2;
+
+			if (victim.compare_exchange_weak(range, PackRange(begin, split), std::memory_order_acq_rel))
+			{
+				// Our own range is empty, only thieves look at it and they skip empty ones
+				ranges[threadIndex].range.store(PackRange(split, end), std::memory_order_release);
+				steals.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex)
+{
+	uint64_t seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+			if (quit) return;
+			seenGeneration = generation;
+		}
+
+		RunItems(threadIndex);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--activeWorkers == 0) done.notify_one();
+	}
+}
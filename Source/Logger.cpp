@@ -1,11 +1,43 @@
 #include "Logger.hpp"
 #include <iostream>
-#include <windows.h>
 #include <chrono>
 #include <ctime>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+enum class ConsoleColor { Green, Red, White };
+
+static void SetConsoleColor(ConsoleColor color)
+{
+#ifdef _WIN32
+	HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
+	switch (color)
+	{
+	case ConsoleColor::Green: SetConsoleTextAttribute(hStdout, FOREGROUND_GREEN | FOREGROUND_INTENSITY); break;
+	case ConsoleColor::Red: SetConsoleTextAttribute(hStdout, FOREGROUND_RED | FOREGROUND_INTENSITY); break;
+	case ConsoleColor::White: SetConsoleTextAttribute(hStdout, 15); break;
+	}
+#else
+	// ANSI escape codes
+	switch (color)
+	{
+	case ConsoleColor::Green: std::cout << "\033[92m"; break;
+	case ConsoleColor::Red: std::cout << "\033[91m"; break;
+	case ConsoleColor::White: std::cout << "\033[0m"; break;
+	}
+#endif
+}
 
 std::vector<LogEntry> Logger::messages;
 
+// Assets log from the loader threads, entries and console lines must not interleave
+static std::mutex logMutex;
+
 std::string Logger::CurrentDateTimeToString()
 {
 	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
@@ -14,15 +46,21 @@ std::string Logger::CurrentDateTimeToString()
 
 	struct tm timeinfo;
 
+#ifdef _WIN32
 	localtime_s(&timeinfo, &now);
+#else
+	localtime_r(&now, &timeinfo);
+#endif
 
-	std::strftime(&output[0], output.size(), "%H:%M:%S", &timeinfo);
+	output.resize(std::strftime(&output[0], output.size(), "%H:%M:%S", &timeinfo));
 
 	return output;
 }
 
 void Logger::Log(const std::string& message)
 {
+	std::lock_guard<std::mutex> lock(logMutex);
+
 	// Add Log In Entries
 	LogEntry entry;
 	entry.type = LogType::LOG_INFO;
@@ -30,19 +68,20 @@ void Logger::Log(const std::string& message)
 	messages.push_back(entry);
 
 	// Make Text Green
-	HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
-	SetConsoleTextAttribute(hStdout, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+	SetConsoleColor(ConsoleColor::Green);
 
 	std::cout << "LOG";
 
 	// Back To White Text
-	SetConsoleTextAttribute(hStdout, 15);
+	SetConsoleColor(ConsoleColor::White);
 
 	std::cout << " | " << CurrentDateTimeToString() << " | " << message << "\n";
 }
 
 void Logger::Error(const std::string& message)
 {
+	std::lock_guard<std::mutex> lock(logMutex);
+
 	// Add Error In Entries
 	LogEntry entry;
 	entry.type = LogType::LOG_ERROR;
@@ -50,13 +89,12 @@ void Logger::Error(const std::string& message)
 	messages.push_back(entry);
 
 	// Make Text Red
-	HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
-	SetConsoleTextAttribute(hStdout, FOREGROUND_RED | FOREGROUND_INTENSITY);
+	SetConsoleColor(ConsoleColor::Red);
 
 	std::cout << "ERR";
 
 	// Back To White Text
-	SetConsoleTextAttribute(hStdout, 15);
+	SetConsoleColor(ConsoleColor::White);
 
 	std::cout << " | " << CurrentDateTimeToString() << " | " << message << "\n";
 }
@@ -0,0 +1,140 @@
+#include "MeshFile.hpp"
+#include "Logger.hpp"
+#include <cstring>
+
+static uint64_t AlignSection(uint64_t offset)
+{
+	return (offset + 63) & ~uint64_t(63);
+}
+
+static void CopyString(char* destination, size_t size, const std::string& source)
+{
+	memset(destination, 0, size);
+	memcpy(destination, source.data(), std::min(source.size(), size - 1));
+}
+
+namespace MeshFile
+{
+	bool Write(const char* filePath, const Mesh& mesh)
+	{
+		MeshFileHeader header;
+		header.vertexCount = static_cast<uint32_t>(mesh.positions.size());
+		header.triangleCount = static_cast<uint32_t>(mesh.triangle.size());
+		header.materialCount = static_cast<uint32_t>(mesh.materials.size());
+		header.sourceACMR = mesh.sourceACMR;
+		header.optimizedACMR = mesh.optimizedACMR;
+		header.boundsMin[0] = mesh.boundsMin.x; header.boundsMin[1] = mesh.boundsMin.y; header.boundsMin[2] = mesh.boundsMin.z;
+		header.boundsMax[0] = mesh.boundsMax.x; header.boundsMax[1] = mesh.boundsMax.y; header.boundsMax[2] = mesh.boundsMax.z;
+
+		header.positionOffset = AlignSection(sizeof(MeshFileHeader));
+		header.uvOffset = AlignSection(header.positionOffset + mesh.positions.size_bytes());
+		header.normalOffset = AlignSection(header.uvOffset + mesh.uvs.size_bytes());
+		header.triangleOffset = AlignSection(header.normalOffset + mesh.normals.size_bytes());
+		header.indexOffset = AlignSection(header.triangleOffset + mesh.triangle.size_bytes());
+		header.materialOffset = AlignSection(header.indexOffset + mesh.indices.size_bytes());
+		header.fileSize = header.materialOffset + header.materialCount * sizeof(MeshFileMaterial);
+
+		std::vector<MeshFileMaterial> materials(header.materialCount);
+		for (uint32_t i = 0; i < header.materialCount; i++)
+		{
+			if (mesh.materials[i].name.size() >= sizeof(materials[i].name) || mesh.materials[i].diffuseTexture.size() >= sizeof(materials[i].diffuseTexture))
+			{
+				Logger::Error("Material name or texture path too long: " + mesh.materials[i].name);
+				return false;
+			}
+
+			CopyString(materials[i].name, sizeof(materials[i].name), mesh.materials[i].name);
+			CopyString(materials[i].diffuseTexture, sizeof(materials[i].diffuseTexture), mesh.materials[i].diffuseTexture);
+			materials[i].address = static_cast<uint32_t>(mesh.materials[i].address);
+		}
+
+		// Built in memory and written in one go, the gaps between sections stay zero
+		std::vector<uint8_t> data(header.fileSize, 0);
+		memcpy(data.data(), &header, sizeof(header));
+		memcpy(data.data() + header.positionOffset, mesh.positions.data(), mesh.positions.size_bytes());
+		memcpy(data.data() + header.uvOffset, mesh.uvs.data(), mesh.uvs.size_bytes());
+		memcpy(data.data() + header.normalOffset, mesh.normals.data(), mesh.normals.size_bytes());
+		memcpy(data.data() + header.triangleOffset, mesh.triangle.data(), mesh.triangle.size_bytes());
+		memcpy(data.data() + header.indexOffset, mesh.indices.data(), mesh.indices.size_bytes());
+		memcpy(data.data() + header.materialOffset, materials.data(), materials.size() * sizeof(MeshFileMaterial));
+
+		std::ofstream file(filePath, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		return file.good();
+	}
+
+	bool Load(const char* filePath, Mesh& mesh)
+	{
+		std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+		if (!mapping->Open(filePath)) return false;
+
+		const uint8_t* data = mapping->GetData();
+		size_t size = mapping->GetSize();
+
+		MeshFileHeader header;
+		if (size < sizeof(header)) return false;
+		memcpy(&header, data, sizeof(header));
+
+		if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION ||
+			header.positionSize != sizeof(tinybvh::bvhvec4) || header.triangleSize != sizeof(Triangle) || header.fileSize != size)
+		{
+			Logger::Error(std::string("Incompatible mesh file ") + filePath);
+			return false;
+		}
+
+		// Sections have to be in the file and aligned for the types that are read from them in place
+		auto validSection = [&](uint64_t offset, uint64_t bytes) { return offset % 64 == 0 && offset <= size && bytes <= size - offset; };
+		if (!validSection(header.positionOffset, uint64_t(header.vertexCount) * sizeof(tinybvh::bvhvec4)) ||
+			!validSection(header.uvOffset, uint64_t(header.vertexCount) * sizeof(float2)) ||
+			!validSection(header.normalOffset, uint64_t(header.vertexCount) * sizeof(float3)) ||
+			!validSection(header.triangleOffset, uint64_t(header.triangleCount) * sizeof(Triangle)) ||
+			!validSection(header.indexOffset, uint64_t(header.triangleCount) * 3 * sizeof(uint32_t)) ||
+			!validSection(header.materialOffset, uint64_t(header.materialCount) * sizeof(MeshFileMaterial)))
+		{
+			Logger::Error(std::string("Corrupt mesh file ") + filePath);
+			return false;
+		}
+
+		// The BVH build and the rasterizer index with these straight from the mapping. -1 is a triangle without material
+		const Triangle* triangles = reinterpret_cast<const Triangle*>(data + header.triangleOffset);
+		const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + header.indexOffset);
+		bool validIndices = true;
+		for (uint64_t i = 0; i < uint64_t(header.triangleCount) * 3; i++) validIndices &= indices[i] < header.vertexCount;
+		for (uint32_t i = 0; i < header.triangleCount; i++)
+		{
+			const Triangle& triangle = triangles[i];
+			for (int corner : triangle.indices) validIndices &= corner >= 0 && uint32_t(corner) < header.vertexCount;
+			validIndices &= triangle.materialIndex >= -1 && triangle.materialIndex < int64_t(header.materialCount);
+		}
+		if (!validIndices)
+		{
+			Logger::Error(std::string("Corrupt mesh file ") + filePath);
+			return false;
+		}
+
+		mesh = Mesh();
+		mesh.positions = { reinterpret_cast<const tinybvh::bvhvec4*>(data + header.positionOffset), header.vertexCount };
+		mesh.uvs = { reinterpret_cast<const float2*>(data + header.uvOffset), header.vertexCount };
+		mesh.normals = { reinterpret_cast<const float3*>(data + header.normalOffset), header.vertexCount };
+		mesh.triangle = { reinterpret_cast<const Triangle*>(data + header.triangleOffset), header.triangleCount };
+		mesh.indices = { reinterpret_cast<const uint32_t*>(data + header.indexOffset), size_t(header.triangleCount) * 3 };
+		mesh.boundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+		mesh.boundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+		mesh.sourceACMR = header.sourceACMR;
+		mesh.optimizedACMR = header.optimizedACMR;
+		mesh.BuildMaterialRanges();
+
+		const MeshFileMaterial* materials = reinterpret_cast<const MeshFileMaterial*>(data + header.materialOffset);
+		for (uint32_t i = 0; i < header.materialCount; i++)
+		{
+			MeshMaterial material;
+			material.name.assign(materials[i].name, strnlen(materials[i].name, sizeof(materials[i].name)));
+			material.diffuseTexture.assign(materials[i].diffuseTexture, strnlen(materials[i].diffuseTexture, sizeof(materials[i].diffuseTexture)));
+			material.address = materials[i].address <= static_cast<uint32_t>(TextureAddress::Mirror) ? static_cast<TextureAddress>(materials[i].address) : TextureAddress::Wrap;
+			mesh.materials.push_back(material);
+		}
+
+		mesh.mapping = mapping;
+		return true;
+	}
+}
@@ -0,0 +1,164 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace MeshOptimizer
+{
+	// Forsyth's scoring, tuned for an LRU of 32 vertices
+	constexpr int LRU_CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	static float VertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0) return -1.f;
+
+		float score = 0.f;
+		if (cachePosition >= 0)
+		{
+			// The corners of the last triangle get a fixed score, so its neighbours don't always win
+			if (cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+			else score = powf(1.f - float(cachePosition - 3) / float(LRU_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+
+		// Vertices with few triangles left are finished first, so they don't end up as stragglers
+		return score + VALENCE_BOOST_SCALE * powf(float(remainingTriangles), -VALENCE_BOOST_POWER);
+	}
+
+	float ACMR(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		if (indices.size() < 3) return 0.f;
+
+		// A vertex is cached while fewer than cacheSize misses happened since it was loaded
+		std::vector<uint32_t> loadedAt(vertexCount, UNUSED);
+		uint32_t misses = 0;
+		for (uint32_t index : indices)
+		{
+			if (loadedAt[index] != UNUSED && misses - loadedAt[index] < cacheSize) continue;
+			loadedAt[index] = misses++;
+		}
+
+		return float(misses) / float(indices.size() / 3);
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		// Triangles of every vertex, the first remaining[v] entries are the ones not emitted yet
+		std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0), adjacency(triangleCount * 3), remaining(vertexCount, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++) remaining[indices[i]]++;
+		for (uint32_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+		std::vector<uint32_t> filled(vertexCount, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			uint32_t v = indices[i];
+			adjacency[adjacencyStart[v] + filled[v]++] = i / 3;
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount), triangleScore(triangleCount, 0.f);
+		for (uint32_t v = 0; v < vertexCount; v++) vertexScore[v] = VertexScore(-1, remaining[v]);
+		for (uint32_t i = 0; i < triangleCount * 3; i++) triangleScore[i / 3] += vertexScore[indices[i]];
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> order;
+		order.reserve(triangleCount);
+
+		uint32_t best = UNUSED;
+		float bestScore = -1.f;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleScore[t] > bestScore) { bestScore = triangleScore[t]; best = t; }
+		}
+
+		uint32_t cache[LRU_CACHE_SIZE + 3], nextCache[LRU_CACHE_SIZE + 3];
+		int cacheCount = 0;
+		uint32_t cursor = 0;
+
+		while (order.size() < triangleCount)
+		{
+			// Nothing in the cache has triangles left, continue with the next one in input order
+			if (best == UNUSED)
+			{
+				while (emitted[cursor]) cursor++;
+				best = cursor;
+			}
+
+			order.push_back(best);
+			emitted[best] = true;
+
+			const uint32_t* corners = &indices[best * 3];
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t v = corners[c];
+				uint32_t* triangles = &adjacency[adjacencyStart[v]];
+				for (uint32_t i = 0; i < remaining[v]; i++)
+				{
+					if (triangles[i] != best) continue;
+					std::swap(triangles[i], triangles[remaining[v] - 1]);
+					remaining[v]--;
+					break;
+				}
+			}
+
+			// The corners move to the front, the rest of the LRU shifts back
+			int nextCount = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				if (c > 0 && corners[c] == corners[0]) continue;
+				if (c > 1 && corners[c] == corners[1]) continue;
+				nextCache[nextCount++] = corners[c];
+			}
+			for (int i = 0; i < cacheCount; i++)
+			{
+				uint32_t v = cache[i];
+				if (v != corners[0] && v != corners[1] && v != corners[2]) nextCache[nextCount++] = v;
+			}
+
+			// Rescore everything that moved, including what just fell out, and pick the best
+			// triangle among the cached vertices
+			best = UNUSED;
+			bestScore = -1.f;
+			for (int i = 0; i < nextCount; i++)
+			{
+				uint32_t v = nextCache[i];
+				cachePosition[v] = i < LRU_CACHE_SIZE ? i : -1;
+
+				float score = VertexScore(cachePosition[v], remaining[v]);
+				float delta = score - vertexScore[v];
+				vertexScore[v] = score;
+
+				const uint32_t* triangles = &adjacency[adjacencyStart[v]];
+				for (uint32_t j = 0; j < remaining[v]; j++) triangleScore[triangles[j]] += delta;
+			}
+			for (int i = 0; i < nextCount && i < LRU_CACHE_SIZE; i++)
+			{
+				uint32_t v = nextCache[i];
+				const uint32_t* triangles = &adjacency[adjacencyStart[v]];
+				for (uint32_t j = 0; j < remaining[v]; j++)
+				{
+					if (triangleScore[triangles[j]] > bestScore) { bestScore = triangleScore[triangles[j]]; best = triangles[j]; }
+				}
+			}
+
+			cacheCount = std::min(nextCount, LRU_CACHE_SIZE);
+			std::copy(nextCache, nextCache + cacheCount, cache);
+		}
+
+		return order;
+	}
+
+	std::vector<uint32_t> OptimizeVertexFetch(std::span<const uint32_t> indices, uint32_t vertexCount)
+	{
+		std::vector<uint32_t> remap(vertexCount, UNUSED);
+		uint32_t next = 0;
+		for (uint32_t index : indices)
+		{
+			if (remap[index] == UNUSED) remap[index] = next++;
+		}
+		return remap;
+	}
+}
@@ -1,9 +1,61 @@
 #include "Model.hpp"
+#include "BVHCache.hpp"
+#include "MeshFile.hpp"
 
-Model::Model(const char* filePath)
+// A converted "<name>.srmesh" next to the OBJ is mapped instead of parsing the OBJ,
+// as long as it isn't older than the OBJ
+static bool LoadConvertedMesh(const std::filesystem::path& path, Mesh& mesh)
 {
-	mesh = LoadMeshTinyObj(filePath);
+	std::filesystem::path meshPath = path;
+	meshPath.replace_extension(".srmesh");
+
+	std::error_code error;
+	if (path.extension() != ".srmesh")
+	{
+		auto meshTime = std::filesystem::last_write_time(meshPath, error);
+		if (error) return false;
+		auto objTime = std::filesystem::last_write_time(path, error);
+		if (!error && objTime > meshTime) return false;
+	}
+
+	return MeshFile::Load(meshPath.string().c_str(), mesh);
+}
+
+Model::Model(const char* filePath, bool load) : filePath(filePath)
+{
+	if (!load) return;
+
+	LoadGeometry();
+	for (size_t i = 0; i < mesh.materials.size(); i++) LoadTexture(i);
+	BuildBVH();
+}
+
+void Model::LoadGeometry()
+{
+	std::filesystem::path path(filePath);
+	if (!LoadConvertedMesh(path, mesh)) mesh = ParseMeshTinyObj(filePath.c_str());
+
+	textureDirectory = path.parent_path().string();
+	if (!textureDirectory.empty() && textureDirectory.back() != '/') textureDirectory += "/";
+	mesh.ResetTextures();
+}
+
+void Model::LoadTexture(size_t material)
+{
+	mesh.LoadTexture(material, textureDirectory);
+	if (compressTextures) mesh.textures[material].Compress();
+}
+
+void Model::BuildBVH()
+{
+	// What BVH8_CPU::BuildHQ does, with the expensive SBVH build coming from the cache
+	wideBVH = new tinybvh::MBVH<8>();
+	BVHCache::LoadOrBuildHQ(filePath, mesh.positions, mesh.indices, wideBVH->bvh);
+	wideBVH->ConvertFrom(wideBVH->bvh, true);
 
 	modelBVH = new tinybvh::BVH8_CPU();
-	modelBVH->BuildHQ(mesh.fatTriangles.data(), static_cast<uint32_t>((mesh.fatTriangles.size() / 3)));
-}
\ No newline at end of file
+	modelBVH->ConvertFrom(*wideBVH, true);
+
+	// Packets are traced through it by SceneTracker::Intersect256Rays
+	packetBVH = &wideBVH->bvh;
+}
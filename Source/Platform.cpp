@@ -0,0 +1,27 @@
+#include "Platform.hpp"
+#include "PlatformHeadless.hpp"
+#include "PlatformWin32.hpp"
+#include "Logger.hpp"
+
+Platform* CreatePlatform(PlatformType type)
+{
+	switch (type)
+	{
+	case PlatformType::Win32:
+#ifdef _WIN32
+		return new Win32Platform();
+#else
+		Logger::Error("Win32 platform is not available on this OS, falling back to headless");
+		return new HeadlessPlatform();
+#endif
+	case PlatformType::Headless:
+		return new HeadlessPlatform();
+	case PlatformType::Default:
+	default:
+#ifdef _WIN32
+		return new Win32Platform();
+#else
+		return new HeadlessPlatform();
+#endif
+	}
+}
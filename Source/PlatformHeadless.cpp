@@ -0,0 +1,81 @@
+#include "PlatformHeadless.hpp"
+#include "Program.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+HeadlessPlatform::HeadlessPlatform(int frameLimit, const std::string& dumpDirectory)
+	: frameLimit(frameLimit), dumpDirectory(dumpDirectory)
+{
+}
+
+bool HeadlessPlatform::OpenWindow(int width, int height, const char* title)
+{
+	frameWidth = width;
+	frameHeight = height;
+
+	if (!dumpDirectory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(dumpDirectory, error);
+		if (error)
+		{
+			Logger::Error("Cannot create frame dump directory " + dumpDirectory);
+			dumpDirectory.clear();
+		}
+	}
+
+	Logger::Log(std::string("Headless platform: ") + title + " " + std::to_string(width) + "x" + std::to_string(height));
+	return true;
+}
+
+void HeadlessPlatform::PumpEvents(Program* program)
+{
+	// No window, so the only way to stop is a frame limit or Quit() from the program itself
+	if (frameLimit > 0 && frameCount >= frameLimit)
+		program->Quit();
+}
+
+void HeadlessPlatform::Present(const uint32_t* pixels, int width, int height)
+{
+	frame = pixels;
+	frameWidth = width;
+	frameHeight = height;
+
+	if (!dumpDirectory.empty())
+	{
+		char fileName[32];
+		std::snprintf(fileName, sizeof(fileName), "frame_%05d.ppm", frameCount);
+		std::string filePath = (std::filesystem::path(dumpDirectory) / fileName).string();
+
+		if (!WritePPM(filePath.c_str(), pixels, width, height))
+			Logger::Error("Failed to write " + filePath);
+	}
+
+	frameCount++;
+}
+
+bool HeadlessPlatform::WritePPM(const char* filePath, const uint32_t* pixels, int width, int height)
+{
+	FILE* file = std::fopen(filePath, "wb");
+	if (!file) return false;
+
+	std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	std::vector<uint8_t> row(width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint32_t pixel = pixels[y * width + x];
+			row[x * 3 + 0] = (pixel >> 16) & 0xFF; // R
+			row[x * 3 + 1] = (pixel >> 8) & 0xFF;  // G
+			row[x * 3 + 2] = pixel & 0xFF;         // B
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+
+	bool ok = std::ferror(file) == 0;
+	std::fclose(file);
+	return ok;
+}
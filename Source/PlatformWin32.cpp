@@ -0,0 +1,124 @@
+#ifdef _WIN32
+#include "PlatformWin32.hpp"
+#include "Program.hpp"
+
+static bool TranslateKey(WPARAM wParam, Key& key)
+{
+	switch (wParam)
+	{
+	case 'T': key = Key::ToggleRenderMode; return true;
+	case 'W': case VK_UP: key = Key::Forward; return true;
+	case 'S': case VK_DOWN: key = Key::Backward; return true;
+	case 'A': case VK_LEFT: key = Key::Left; return true;
+	case 'D': case VK_RIGHT: key = Key::Right; return true;
+	case VK_ESCAPE: key = Key::Escape; return true;
+	}
+	return false;
+}
+
+Win32Platform::Win32Platform()
+{
+	ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
+	bitmapInfo.bmiHeader.biSize = sizeof(bitmapInfo.bmiHeader);
+	bitmapInfo.bmiHeader.biPlanes = 1;
+	bitmapInfo.bmiHeader.biBitCount = 32;
+	bitmapInfo.bmiHeader.biCompression = BI_RGB;
+}
+
+LRESULT CALLBACK Win32Platform::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	Win32Platform* platform = reinterpret_cast<Win32Platform*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+	Key key;
+
+	switch (uMsg) {
+	case WM_DESTROY:
+		PostQuitMessage(0);
+		return 0;
+
+	case WM_PAINT: {
+		PAINTSTRUCT ps;
+		HDC hdc = BeginPaint(hwnd, &ps);
+
+		if (platform && platform->frame) {
+			StretchDIBits(hdc, 0, 0, platform->frameWidth, platform->frameHeight,
+				0, 0, platform->frameWidth, platform->frameHeight,
+				platform->frame, &platform->bitmapInfo, DIB_RGB_COLORS, SRCCOPY);
+		}
+
+		EndPaint(hwnd, &ps);
+		return 0;
+	}
+
+	case WM_KEYDOWN:
+		if (platform && platform->listener && TranslateKey(wParam, key))
+		{
+			if (key == Key::Escape) PostQuitMessage(0);
+			else platform->listener->OnKeyDown(key);
+		}
+		return 0;
+
+	case WM_KEYUP:
+		if (platform && platform->listener && TranslateKey(wParam, key))
+			platform->listener->OnKeyUp(key);
+		return 0;
+	}
+
+	return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+bool Win32Platform::OpenWindow(int width, int height, const char* title)
+{
+	HINSTANCE instance = GetModuleHandleA(0);
+
+	std::wstring wideTitle(title, title + strlen(title));
+
+	WNDCLASSW wc = {};
+	wc.hInstance = instance;
+	wc.hIcon = LoadIcon(instance, IDI_APPLICATION);
+	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+	wc.lpszClassName = wideTitle.c_str();
+	wc.lpfnWndProc = WindowProc;
+
+	if (!RegisterClassW(&wc)) return false;
+
+	int dwStyle = WS_OVERLAPPEDWINDOW;
+
+	window = CreateWindowExW(0, wideTitle.c_str(), wideTitle.c_str(), dwStyle, 100, 100, width, height, NULL, NULL, instance, NULL);
+
+	if (!window) return false;
+
+	SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
+	ShowWindow(window, SW_SHOW);
+	return true;
+}
+
+void Win32Platform::PumpEvents(Program* program)
+{
+	MSG msg;
+	listener = program;
+
+	// WM_QUIT is posted to the thread, not the window, so don't filter on hwnd
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		if (msg.message == WM_QUIT)
+			program->Quit();
+
+		TranslateMessage(&msg);
+		DispatchMessageA(&msg);
+	}
+
+	listener = nullptr;
+}
+
+void Win32Platform::Present(const uint32_t* pixels, int width, int height)
+{
+	frame = pixels;
+	frameWidth = width;
+	frameHeight = height;
+	bitmapInfo.bmiHeader.biWidth = width;
+	bitmapInfo.bmiHeader.biHeight = -height; // top-down
+
+	InvalidateRect(window, nullptr, FALSE);
+}
+#endif
@@ -1,6 +1,6 @@
 #include "Program.hpp"
 
-Program::Program(const char* title)
+Program::Program(const char* title, Platform* platform) : title(title), platform(platform)
 {
 	Init();
 }
@@ -8,9 +8,10 @@ Program::Program(const char* title)
 Program::~Program()
 {
 	Shutdown();
+	delete platform;
 }
 
 void Program::Quit()
 {
-
-}
\ No newline at end of file
+	isRunning = false;
+}
@@ -0,0 +1,481 @@
+#include "Rasterizer.hpp"
+#include "RasterizerKernels.hpp"
+#include "CpuFeatures.hpp"
+#include "Logger.hpp"
+#include <cstring>
+#include <limits>
+
+Rasterizer::Rasterizer(uint32_t* framebuffer, float* depthBuffer, int width, int height, JobSystem* jobs)
+	: framebuffer(framebuffer), depthBuffer(depthBuffer), width(width), height(height), jobs(jobs)
+{
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	bins.resize(tilesX * tilesY);
+
+	blocksX = (width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	blocksY = (height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	blockMaxDepth.resize(blocksX * blocksY);
+	blockDirty.resize(blocksX * blocksY);
+	tileMaxDepth.resize(tilesX * tilesY);
+	tileStats.resize(tilesX * tilesY);
+
+	SetKernel(RasterKernel::Auto);
+}
+
+void Rasterizer::SetKernel(RasterKernel requested)
+{
+	const CpuFeatures& cpu = GetCpuFeatures();
+
+	kernelType = RasterKernel::Scalar;
+
+#ifdef RASTERIZER_X64
+	bool wantAVX512 = requested == RasterKernel::Auto || requested == RasterKernel::AVX512;
+	bool wantAVX2 = wantAVX512 || requested == RasterKernel::AVX2;
+
+	if (wantAVX512 && cpu.avx512f && cpu.avx512bw && cpu.avx512dq && cpu.avx2 && cpu.fma)
+	{
+		kernelType = RasterKernel::AVX512;
+	}
+	else if (wantAVX2 && cpu.avx2 && cpu.fma)
+	{
+		kernelType = RasterKernel::AVX2;
+	}
+#endif
+
+	SelectKernel();
+
+	if (requested != RasterKernel::Auto && requested != kernelType)
+		Logger::Error(std::string("Raster kernel ") + GetKernelName(requested) + " not supported by this CPU");
+}
+
+void Rasterizer::SetTextureFilter(TextureFilter filter)
+{
+	textureFilter = filter;
+	SelectKernel();
+}
+
+// Every kernel is instantiated per texture filter, so the pixel loop doesn't branch on it
+template<TextureFilter filter>
+static PlotTriangleKernel GetKernelFunction(RasterKernel type)
+{
+	switch (type)
+	{
+#ifdef RASTERIZER_X64
+	case RasterKernel::AVX512: return PlotTriangleAVX512<filter>;
+	case RasterKernel::AVX2: return PlotTriangleAVX2<filter>;
+#endif
+	default: return PlotTriangleScalar<filter>;
+	}
+}
+
+void Rasterizer::SelectKernel()
+{
+	switch (textureFilter)
+	{
+	case TextureFilter::Nearest: kernel = GetKernelFunction<TextureFilter::Nearest>(kernelType); break;
+	case TextureFilter::NearestMip: kernel = GetKernelFunction<TextureFilter::NearestMip>(kernelType); break;
+	case TextureFilter::Bilinear: kernel = GetKernelFunction<TextureFilter::Bilinear>(kernelType); break;
+	case TextureFilter::Trilinear: kernel = GetKernelFunction<TextureFilter::Trilinear>(kernelType); break;
+	}
+}
+
+const char* Rasterizer::GetTextureFilterName(TextureFilter filter)
+{
+	switch (filter)
+	{
+	case TextureFilter::Nearest: return "nearest";
+	case TextureFilter::NearestMip: return "mip";
+	case TextureFilter::Bilinear: return "bilinear";
+	case TextureFilter::Trilinear: return "trilinear";
+	}
+	return "unknown";
+}
+
+TextureFilter Rasterizer::ParseTextureFilterName(const char* name)
+{
+	if (strcmp(name, "nearest") == 0) return TextureFilter::Nearest;
+	if (strcmp(name, "bilinear") == 0) return TextureFilter::Bilinear;
+	if (strcmp(name, "trilinear") == 0) return TextureFilter::Trilinear;
+	return TextureFilter::NearestMip;
+}
+
+const char* Rasterizer::GetKernelName(RasterKernel kernel)
+{
+	switch (kernel)
+	{
+	case RasterKernel::Auto: return "auto";
+	case RasterKernel::Scalar: return "scalar";
+	case RasterKernel::AVX2: return "avx2";
+	case RasterKernel::AVX512: return "avx512";
+	}
+	return "unknown";
+}
+
+RasterKernel Rasterizer::ParseKernelName(const char* name)
+{
+	if (strcmp(name, "scalar") == 0) return RasterKernel::Scalar;
+	if (strcmp(name, "avx2") == 0) return RasterKernel::AVX2;
+	if (strcmp(name, "avx512") == 0) return RasterKernel::AVX512;
+	return RasterKernel::Auto;
+}
+
+OcclusionStats Rasterizer::GetOcclusionStats() const
+{
+	OcclusionStats total;
+	for (const OcclusionStats& tile : tileStats)
+	{
+		total.trianglesOccluded += tile.trianglesOccluded;
+		total.blocksOccluded += tile.blocksOccluded;
+	}
+	return total;
+}
+
+void Rasterizer::ClearDepth(float depth)
+{
+	std::fill(depthBuffer, depthBuffer + width * height, depth);
+	std::fill(blockMaxDepth.begin(), blockMaxDepth.end(), depth);
+	std::fill(blockDirty.begin(), blockDirty.end(), uint8_t(0));
+	std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), depth);
+}
+
+void Rasterizer::BeginFrame(ScratchRegion& frameScratch)
+{
+	// The arena was reset, what the bins pointed to is gone
+	scratch = &frameScratch;
+	for (auto& bin : bins) bin = TileBin();
+	for (auto& tile : tileStats) tile = OcclusionStats();
+}
+
+bool Rasterizer::Setup(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const TextureSampler* texture, RasterTriangle& tri) const
+{
+	if (!SetupTriangle(v0, v1, v2, tri)) return false;
+
+	tri.texture = texture;
+	return true;
+}
+
+void Rasterizer::Bin(const RasterTriangle* tri)
+{
+	for (int ty = tri->minY / TILE_SIZE; ty <= tri->maxY / TILE_SIZE; ty++)
+	{
+		for (int tx = tri->minX / TILE_SIZE; tx <= tri->maxX / TILE_SIZE; tx++)
+		{
+			TileBin& bin = bins[ty * tilesX + tx];
+			if (bin.last == nullptr || bin.last->count == BIN_CHUNK_SIZE)
+			{
+				BinChunk* chunk = static_cast<BinChunk*>(scratch->Allocate(sizeof(BinChunk), alignof(BinChunk)));
+				chunk->next = nullptr;
+				chunk->count = 0;
+				if (bin.last) bin.last->next = chunk;
+				else bin.first = chunk;
+				bin.last = chunk;
+			}
+			bin.last->triangles[bin.last->count++] = tri;
+		}
+	}
+}
+
+bool Rasterizer::SetupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, RasterTriangle& tri) const
+{
+	// Snapped positions have to stay small enough for the edge functions to fit in 64 bits
+	constexpr float maxCoordinate = float(1 << 22);
+	for (const ScreenVertex* v : { &v0, &v1, &v2 })
+	{
+		if (!(std::abs(v->x) < maxCoordinate && std::abs(v->y) < maxCoordinate))
+			return false;
+	}
+
+	const ScreenVertex* verts[3] = { &v0, &v1, &v2 };
+	int64_t X[3], Y[3];
+	for (int i = 0; i < 3; i++)
+	{
+		X[i] = static_cast<int64_t>(std::lround(verts[i]->x * SUBPIXEL_STEPS));
+		Y[i] = static_cast<int64_t>(std::lround(verts[i]->y * SUBPIXEL_STEPS));
+	}
+
+	// Make the winding consistent so the inside is always E >= 0
+	int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+	if (area == 0) return false; // Degenerate
+	if (area < 0)
+	{
+		std::swap(verts[1], verts[2]);
+		std::swap(X[1], X[2]);
+		std::swap(Y[1], Y[2]);
+		area = -area;
+	}
+
+	// Bounding box
+	int64_t minXfp = std::min({ X[0], X[1], X[2] }), maxXfp = std::max({ X[0], X[1], X[2] });
+	int64_t minYfp = std::min({ Y[0], Y[1], Y[2] }), maxYfp = std::max({ Y[0], Y[1], Y[2] });
+	tri.minX = static_cast<int>(std::max<int64_t>(0, minXfp >> SUBPIXEL_BITS));
+	tri.maxX = static_cast<int>(std::min<int64_t>(width - 1, maxXfp >> SUBPIXEL_BITS));
+	tri.minY = static_cast<int>(std::max<int64_t>(0, minYfp >> SUBPIXEL_BITS));
+	tri.maxY = static_cast<int>(std::min<int64_t>(height - 1, maxYfp >> SUBPIXEL_BITS));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY) return false; // Off screen
+
+	// Edge i is the one opposite of vertex i
+	for (int i = 0; i < 3; i++)
+	{
+		int a = (i + 1) % 3, b = (i + 2) % 3;
+		tri.A[i] = Y[a] - Y[b];
+		tri.B[i] = X[b] - X[a];
+		tri.C[i] = X[a] * Y[b] - X[b] * Y[a];
+
+		// Top-left rule: pixels exactly on an edge only belong to the triangle if it's a top or left edge
+		bool topLeft = tri.A[i] > 0 || (tri.A[i] == 0 && tri.B[i] > 0);
+		if (!topLeft) tri.C[i] -= 1;
+	}
+
+	// Attribute planes from the barycentric gradients, in pixel units
+	double invArea = 1.0 / static_cast<double>(area);
+	double x0 = double(X[0]) / SUBPIXEL_STEPS, y0 = double(Y[0]) / SUBPIXEL_STEPS;
+
+	auto makePlane = [&](double a0, double a1, double a2) -> AttributePlane
+		{
+			double dx = (tri.A[0] * a0 + tri.A[1] * a1 + tri.A[2] * a2) * SUBPIXEL_STEPS * invArea;
+			double dy = (tri.B[0] * a0 + tri.B[1] * a1 + tri.B[2] * a2) * SUBPIXEL_STEPS * invArea;
+			return { float(a0 - dx * x0 - dy * y0), float(dx), float(dy) };
+		};
+
+	tri.invZ = makePlane(1.0 / verts[0]->z, 1.0 / verts[1]->z, 1.0 / verts[2]->z);
+	tri.invW = makePlane(verts[0]->invW, verts[1]->invW, verts[2]->invW);
+	tri.uDivW = makePlane(verts[0]->uDivW, verts[1]->uDivW, verts[2]->uDivW);
+	tri.vDivW = makePlane(verts[0]->vDivW, verts[1]->vDivW, verts[2]->vDivW);
+
+	// 1 / z is linear over the triangle, so the nearest point is the vertex with the largest
+	// 1 / z. The margin covers the rounding of the interpolated value in the kernels. If 1 / z
+	// crosses 0 there is no useful bound.
+	float maxInvZ = std::max({ 1.f / verts[0]->z, 1.f / verts[1]->z, 1.f / verts[2]->z });
+	float minInvZ = std::min({ 1.f / verts[0]->z, 1.f / verts[1]->z, 1.f / verts[2]->z });
+	tri.minZ = minInvZ > 0.f ? (1.f / maxInvZ) * (1.f - 1e-4f) : -std::numeric_limits<float>::infinity();
+
+	return true;
+}
+
+void Rasterizer::Flush()
+{
+	jobs->ParallelFor(static_cast<uint32_t>(bins.size()), [this](uint32_t tileIndex, uint32_t)
+		{
+			RasterizeTile(tileIndex);
+		});
+}
+
+void Rasterizer::RasterizeTile(uint32_t tileIndex)
+{
+	const TileBin& bin = bins[tileIndex];
+	if (bin.first == nullptr) return;
+
+	int tileMinX = (tileIndex % tilesX) * TILE_SIZE;
+	int tileMinY = (tileIndex / tilesX) * TILE_SIZE;
+	int tileMaxX = std::min(tileMinX + TILE_SIZE, width) - 1;
+	int tileMaxY = std::min(tileMinY + TILE_SIZE, height) - 1;
+
+	RasterTarget target = { framebuffer, depthBuffer, width };
+	OcclusionStats& occlusion = tileStats[tileIndex];
+
+	for (const BinChunk* chunk = bin.first; chunk; chunk = chunk->next)
+	{
+		for (uint32_t i = 0; i < chunk->count; i++)
+		{
+			const RasterTriangle& tri = *chunk->triangles[i];
+
+			if (tri.minZ >= tileMaxDepth[tileIndex])
+			{
+				occlusion.trianglesOccluded++;
+				continue;
+			}
+
+			// Bounding box, clipped to the tile
+			int minX = std::max(tileMinX, tri.minX);
+			int maxX = std::min(tileMaxX, tri.maxX);
+			int minY = std::max(tileMinY, tri.minY);
+			int maxY = std::min(tileMaxY, tri.maxY);
+
+			// Per row of blocks, hand every run of visible blocks to the kernel in one call
+			bool refreshed = false;
+			for (int by = minY / HIZ_BLOCK_SIZE; by <= maxY / HIZ_BLOCK_SIZE; by++)
+			{
+				int rowMinY = std::max(minY, by * HIZ_BLOCK_SIZE);
+				int rowMaxY = std::min(maxY, by * HIZ_BLOCK_SIZE + HIZ_BLOCK_SIZE - 1);
+
+				int firstBlock = minX / HIZ_BLOCK_SIZE, lastBlock = maxX / HIZ_BLOCK_SIZE;
+				int runStart = -1;
+				for (int bx = firstBlock; bx <= lastBlock + 1; bx++)
+				{
+					bool visible = false;
+					if (bx <= lastBlock)
+					{
+						int blockIndex = by * blocksX + bx;
+						visible = BlockVisible(blockIndex, tri.minZ, refreshed);
+						if (!visible) occlusion.blocksOccluded++;
+					}
+
+					if (visible && runStart < 0) runStart = bx;
+					if (!visible && runStart >= 0)
+					{
+						int runMinX = std::max(minX, runStart * HIZ_BLOCK_SIZE);
+						int runMaxX = std::min(maxX, bx * HIZ_BLOCK_SIZE - 1);
+						kernel(tri, target, runMinX, rowMinY, runMaxX, rowMaxY);
+
+						for (int b = runStart; b < bx; b++) blockDirty[by * blocksX + b] = 1;
+						runStart = -1;
+					}
+				}
+			}
+
+			// Tighten the tile bound with whatever block bounds got tighter
+			if (refreshed)
+			{
+				int firstBlockX = tileMinX / HIZ_BLOCK_SIZE, lastBlockX = tileMaxX / HIZ_BLOCK_SIZE;
+				int firstBlockY = tileMinY / HIZ_BLOCK_SIZE, lastBlockY = tileMaxY / HIZ_BLOCK_SIZE;
+
+				float tileMax = -std::numeric_limits<float>::infinity();
+				for (int by = firstBlockY; by <= lastBlockY; by++)
+					for (int bx = firstBlockX; bx <= lastBlockX; bx++)
+						tileMax = std::max(tileMax, blockMaxDepth[by * blocksX + bx]);
+				tileMaxDepth[tileIndex] = tileMax;
+			}
+		}
+	}
+}
+
+bool Rasterizer::BlockVisible(int blockIndex, float minZ, bool& refreshed)
+{
+	if (minZ < blockMaxDepth[blockIndex])
+	{
+		if (!blockDirty[blockIndex]) return true;
+
+		blockMaxDepth[blockIndex] = BlockMaxDepth(blockIndex);
+		blockDirty[blockIndex] = 0;
+		refreshed = true;
+	}
+	return minZ < blockMaxDepth[blockIndex];
+}
+
+float Rasterizer::BlockMaxDepth(int blockIndex) const
+{
+	int minX = (blockIndex % blocksX) * HIZ_BLOCK_SIZE;
+	int minY = (blockIndex / blocksX) * HIZ_BLOCK_SIZE;
+	int maxX = std::min(minX + HIZ_BLOCK_SIZE, width);
+	int maxY = std::min(minY + HIZ_BLOCK_SIZE, height);
+
+	float maxDepth = -std::numeric_limits<float>::infinity();
+	for (int y = minY; y < maxY; y++)
+	{
+		const float* row = depthBuffer + y * width;
+		for (int x = minX; x < maxX; x++)
+			maxDepth = row[x] > maxDepth ? row[x] : maxDepth;
+	}
+	return maxDepth;
+}
+
+template<TextureFilter filter>
+void PlotTriangleScalar(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY)
+{
+	const TextureSampler& tex = *tri.texture;
+
+	// Edge functions at the first pixel center, then only constant steps
+	int64_t px = int64_t(minX) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+	int64_t py = int64_t(minY) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+
+	int64_t row0 = tri.A[0] * px + tri.B[0] * py + tri.C[0];
+	int64_t row1 = tri.A[1] * px + tri.B[1] * py + tri.C[1];
+	int64_t row2 = tri.A[2] * px + tri.B[2] * py + tri.C[2];
+
+	const int64_t stepX0 = tri.A[0] * SUBPIXEL_STEPS, stepY0 = tri.B[0] * SUBPIXEL_STEPS;
+	const int64_t stepX1 = tri.A[1] * SUBPIXEL_STEPS, stepY1 = tri.B[1] * SUBPIXEL_STEPS;
+	const int64_t stepX2 = tri.A[2] * SUBPIXEL_STEPS, stepY2 = tri.B[2] * SUBPIXEL_STEPS;
+
+	int finestLevel = INT_MAX; // Of the pixels drawn, for the texture feedback
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		int64_t e0 = row0, e1 = row1, e2 = row2;
+
+		// Attributes are the row start plus dx times the distance to it, not stepped, so the
+		// SIMD kernels get the same bits no matter how wide their blocks are
+		float fx = minX + 0.5f, fy = y + 0.5f;
+		float invZStart = tri.invZ.At(fx, fy);
+		float invWStart = tri.invW.At(fx, fy);
+		float uDivWStart = tri.uDivW.At(fx, fy);
+		float vDivWStart = tri.vDivW.At(fx, fy);
+
+		for (int x = minX; x <= maxX; ++x)
+		{
+			if ((e0 | e1 | e2) >= 0) // All three non negative
+			{
+				float offset = float(x - minX);
+				float invZ = invZStart + tri.invZ.dx * offset;
+				float z = 1.0f / invZ;
+
+				int index = y * target.width + x;
+				if (z < target.depthBuffer[index])
+				{
+					float invW = invWStart + tri.invW.dx * offset;
+					float u = (uDivWStart + tri.uDivW.dx * offset) / invW;
+					float v = (vDivWStart + tri.vDivW.dx * offset) / invW;
+
+					// Texel footprint before clamping, the derivatives need the real u and v
+					float footprint = 0.f;
+					if constexpr (filter != TextureFilter::Nearest)
+						footprint = TexelFootprint(tri, u, v, 1.0f / invW);
+
+					u = tex.Address(u);
+					v = tex.Address(v);
+
+					// Sample texture, levels that aren't resident come from the finest one that is
+					uint32_t color;
+					int level = 0;
+					if constexpr (filter == TextureFilter::Nearest)
+					{
+						if (tex.minLevel == 0)
+						{
+							int texX = std::clamp(int(u * tex.width), 0, tex.widthMask);
+							int texY = std::clamp(int(v * tex.height), 0, tex.heightMask);
+							color = tex.Fetch(texX, texY);
+						}
+						else
+						{
+							color = tex.SampleNearest(u, v, tex.minLevel);
+						}
+					}
+					else if constexpr (filter == TextureFilter::NearestMip)
+					{
+						level = NearestMipLevel(footprint, tex.levelCount);
+						color = tex.SampleNearest(u, v, std::max(level, tex.minLevel));
+					}
+					else if constexpr (filter == TextureFilter::Bilinear)
+					{
+						level = NearestMipLevel(footprint, tex.levelCount);
+						color = tex.SampleBilinear(u, v, std::max(level, tex.minLevel));
+					}
+					else
+					{
+						float lod = 0.5f * std::log2(footprint);
+						level = lod > 0.f ? int(std::min(lod, float(tex.levelCount - 1))) : 0;
+						color = tex.SampleTrilinear(u, v, lod);
+					}
+					finestLevel = std::min(finestLevel, level);
+
+					// Write to framebuffer
+					target.depthBuffer[index] = z;
+					target.framebuffer[index] = color | 0xFF000000;
+#ifdef MEASURE_TEXTURE_CACHE
+					TextureCacheModel::CountPixel();
+#endif
+				}
+			}
+
+			e0 += stepX0; e1 += stepX1; e2 += stepX2;
+		}
+
+		row0 += stepY0; row1 += stepY1; row2 += stepY2;
+	}
+
+	if (tex.feedback && finestLevel != INT_MAX) tex.feedback->Record(finestLevel);
+}
+
+template void PlotTriangleScalar<TextureFilter::Nearest>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleScalar<TextureFilter::NearestMip>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleScalar<TextureFilter::Bilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleScalar<TextureFilter::Trilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
@@ -0,0 +1,382 @@
+#include "RasterizerKernels.hpp"
+
+#ifdef RASTERIZER_X64
+#include <immintrin.h>
+#include <cmath>
+#include <cstddef>
+
+// Squared texel footprint of 8 pixels, see TexelFootprint
+TARGET_AVX2 static inline __m256 TexelFootprintAVX2(const RasterTriangle& tri, __m256 u, __m256 v, __m256 w)
+{
+	const TextureSampler& tex = *tri.texture;
+	__m256 texW = _mm256_set1_ps(float(tex.width)), texH = _mm256_set1_ps(float(tex.height));
+
+	__m256 dudx = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(tri.uDivW.dx), _mm256_mul_ps(u, _mm256_set1_ps(tri.invW.dx))), w), texW);
+	__m256 dvdx = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(tri.vDivW.dx), _mm256_mul_ps(v, _mm256_set1_ps(tri.invW.dx))), w), texH);
+	__m256 dudy = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(tri.uDivW.dy), _mm256_mul_ps(u, _mm256_set1_ps(tri.invW.dy))), w), texW);
+	__m256 dvdy = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(tri.vDivW.dy), _mm256_mul_ps(v, _mm256_set1_ps(tri.invW.dy))), w), texH);
+
+	__m256 lengthX = _mm256_add_ps(_mm256_mul_ps(dudx, dudx), _mm256_mul_ps(dvdx, dvdx));
+	__m256 lengthY = _mm256_add_ps(_mm256_mul_ps(dudy, dudy), _mm256_mul_ps(dvdy, dvdy));
+	return _mm256_max_ps(lengthX, lengthY);
+}
+
+// TiledTexelIndex of 8 texels, rowPitch is TiledRowPitch of their level width
+TARGET_AVX2 static inline __m256i TiledTexelIndexAVX2(__m256i x, __m256i y, __m256i rowPitch)
+{
+	const __m256i mask = _mm256_set1_epi32(TEXTURE_TILE_SIZE - 1);
+	__m256i tileRow = _mm256_mullo_epi32(_mm256_srli_epi32(y, TEXTURE_TILE_SHIFT), rowPitch);
+	__m256i tileColumn = _mm256_slli_epi32(_mm256_andnot_si256(mask, x), TEXTURE_TILE_SHIFT);
+	__m256i inTile = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(y, mask), TEXTURE_TILE_SHIFT), _mm256_and_si256(x, mask));
+	return _mm256_add_epi32(_mm256_add_epi32(tileRow, tileColumn), inTile);
+}
+
+// TextureSampler::Address of 8 lanes. Clamp maps NaN to 0
+TARGET_AVX2 static inline __m256 AddressAVX2(TextureAddress address, __m256 u)
+{
+	const __m256 one = _mm256_set1_ps(1.f);
+	switch (address)
+	{
+	case TextureAddress::Wrap: return _mm256_sub_ps(u, _mm256_floor_ps(u));
+	case TextureAddress::Mirror:
+	{
+		const __m256 two = _mm256_set1_ps(2.f);
+		__m256 m = _mm256_sub_ps(u, _mm256_mul_ps(two, _mm256_floor_ps(_mm256_mul_ps(u, _mm256_set1_ps(0.5f)))));
+		return _mm256_blendv_ps(m, _mm256_sub_ps(two, m), _mm256_cmp_ps(m, one, _CMP_GT_OQ));
+	}
+	default: return _mm256_min_ps(_mm256_max_ps(u, _mm256_setzero_ps()), one);
+	}
+}
+
+// TextureSampler::AddressPair of 8 lanes
+TARGET_AVX2 static inline void AddressPairAVX2(TextureAddress address, __m256i x, __m256i size, __m256i& x0, __m256i& x1)
+{
+	const __m256i minusOne = _mm256_set1_epi32(-1);
+	__m256i next = _mm256_sub_epi32(x, minusOne);
+	__m256i last = _mm256_add_epi32(size, minusOne);
+	if (address == TextureAddress::Wrap)
+	{
+		__m256i inside0 = _mm256_and_si256(_mm256_cmpgt_epi32(x, minusOne), _mm256_cmpgt_epi32(size, x));
+		__m256i inside1 = _mm256_and_si256(_mm256_cmpgt_epi32(next, minusOne), _mm256_cmpgt_epi32(size, next));
+		x0 = _mm256_blendv_epi8(last, x, inside0);
+		x1 = _mm256_and_si256(next, inside1);
+	}
+	else
+	{
+		x0 = _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), last);
+		x1 = _mm256_min_epi32(_mm256_max_epi32(next, _mm256_setzero_si256()), last);
+	}
+}
+
+// LerpColor of 8 lanes, t in [0, 256]
+TARGET_AVX2 static inline __m256i LerpColorAVX2(__m256i a, __m256i b, __m256i t)
+{
+	const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	__m256i s = _mm256_sub_epi32(_mm256_set1_epi32(256), t);
+	__m256i rb = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(a, mask), s), _mm256_mullo_epi32(_mm256_and_si256(b, mask), t));
+	__m256i ag = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(a, 8), mask), s), _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(b, 8), mask), t));
+	rb = _mm256_and_si256(_mm256_srli_epi32(rb, 8), mask);
+	ag = _mm256_and_si256(_mm256_srli_epi32(ag, 8), mask);
+	return _mm256_or_si256(rb, _mm256_slli_epi32(ag, 8));
+}
+
+// Bits of the lanes in mask whose entry of decodedBlocks holds another block
+TARGET_AVX2 static inline int MissingBlocksAVX2(__m256i entry, __m256i block, __m256i mask)
+{
+	__m256i cached = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(decodedBlocks), entry, mask, 1);
+	return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpeq_epi32(cached, block), mask)));
+}
+
+// Texels at index (from the start of the chain) of the lanes in mask. Block compressed
+// textures are read from decodedBlocks, the blocks that aren't there are decoded first
+// with TextureSampler::GetBlock, so the texels are the ones the scalar kernel reads
+TARGET_AVX2 static inline __m256i GatherTexelsAVX2(const TextureSampler& tex, __m256i index, __m256i mask)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	if (!tex.blocks) return _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int*>(tex.texels), index, mask, 4);
+
+	// DecodedBlockSlot, entries are found by byte offset
+	const int* texels = reinterpret_cast<const int*>(decodedBlocks) + offsetof(DecodedBlock, texels) / 4;
+	__m256i block = _mm256_add_epi32(_mm256_set1_epi32(int(tex.firstBlock)), _mm256_srli_epi32(index, 4));
+	__m256i slot = _mm256_srli_epi32(_mm256_mullo_epi32(block, _mm256_set1_epi32(int(0x9E3779B1u))), 32 - DECODED_BLOCK_CACHE_BITS);
+	__m256i entry = _mm256_mullo_epi32(slot, _mm256_set1_epi32(sizeof(DecodedBlock)));
+	__m256i texel = _mm256_add_epi32(entry, _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(15)), 2));
+
+	int missing = MissingBlocksAVX2(entry, block, mask);
+	if (!missing) return _mm256_mask_i32gather_epi32(zero, texels, texel, mask, 1);
+
+	alignas(32) uint32_t laneIndex[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(laneIndex), index);
+	for (int bits = missing; bits; bits &= bits - 1) tex.GetBlock(laneIndex[LowestBit(bits)] >> 4);
+
+	// Lanes can want different blocks that share an entry, those are read one at a time
+	missing = MissingBlocksAVX2(entry, block, mask);
+	__m256i colors = _mm256_mask_i32gather_epi32(zero, texels, texel, mask, 1);
+	if (!missing) return colors;
+
+	alignas(32) uint32_t laneColor[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(laneColor), colors);
+	for (int bits = missing; bits; bits &= bits - 1)
+	{
+		int lane = LowestBit(bits);
+		laneColor[lane] = tex.GetBlock(laneIndex[lane] >> 4).texels[laneIndex[lane] & 15];
+	}
+	return _mm256_load_si256(reinterpret_cast<const __m256i*>(laneColor));
+}
+
+// Size and position of the mip level of every lane. Level sizes halve down to 1, offsets
+// come from the level table (3 ints per MipLevel)
+struct LevelsAVX2
+{
+	__m256i width, height, offset, rowPitch;
+};
+
+TARGET_AVX2 static inline LevelsAVX2 GetLevelsAVX2(const TextureSampler& tex, __m256i level)
+{
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i tileMask = _mm256_set1_epi32(TEXTURE_TILE_SIZE - 1);
+
+	LevelsAVX2 levels;
+	levels.width = _mm256_max_epi32(_mm256_srlv_epi32(_mm256_set1_epi32(tex.width), level), one);
+	levels.height = _mm256_max_epi32(_mm256_srlv_epi32(_mm256_set1_epi32(tex.height), level), one);
+	levels.offset = _mm256_i32gather_epi32(&tex.levels->offset, _mm256_mullo_epi32(level, _mm256_set1_epi32(3)), 4);
+	levels.rowPitch = _mm256_slli_epi32(_mm256_andnot_si256(tileMask, _mm256_add_epi32(levels.width, tileMask)), TEXTURE_TILE_SHIFT); // TiledRowPitch
+	return levels;
+}
+
+// Same as NearestMipLevel: the level comes from the float exponent of the footprint
+TARGET_AVX2 static inline __m256i NearestMipLevelAVX2(__m256 footprint, int levelCount)
+{
+	footprint = _mm256_min_ps(footprint, _mm256_set1_ps(1e30f)); // NaN turns into 1e30 as well
+	__m256i exponent = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(_mm256_castps_si256(footprint), 23), _mm256_set1_epi32(0xFF)), _mm256_set1_epi32(127));
+	__m256i level = _mm256_srai_epi32(_mm256_add_epi32(exponent, _mm256_set1_epi32(1)), 1);
+	return _mm256_min_epi32(_mm256_max_epi32(level, _mm256_setzero_si256()), _mm256_set1_epi32(levelCount - 1));
+}
+
+// TextureSampler::SampleBilinear of 8 lanes, each in its own level. Only lanes in mask are read
+TARGET_AVX2 static inline __m256i SampleBilinearAVX2(const TextureSampler& tex, __m256i level, __m256 u, __m256 v, __m256i mask)
+{
+	const __m256 half = _mm256_set1_ps(0.5f), steps = _mm256_set1_ps(256.f);
+	LevelsAVX2 levels = GetLevelsAVX2(tex, level);
+
+	__m256 x = _mm256_sub_ps(_mm256_mul_ps(u, _mm256_cvtepi32_ps(levels.width)), half);
+	__m256 y = _mm256_sub_ps(_mm256_mul_ps(v, _mm256_cvtepi32_ps(levels.height)), half);
+	__m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y);
+	__m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(x, fx), steps));
+	__m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(y, fy), steps));
+
+	__m256i x0, x1, y0, y1;
+	AddressPairAVX2(tex.address, _mm256_cvttps_epi32(fx), levels.width, x0, x1);
+	AddressPairAVX2(tex.address, _mm256_cvttps_epi32(fy), levels.height, y0, y1);
+
+	__m256i c00 = GatherTexelsAVX2(tex, _mm256_add_epi32(levels.offset, TiledTexelIndexAVX2(x0, y0, levels.rowPitch)), mask);
+	__m256i c10 = GatherTexelsAVX2(tex, _mm256_add_epi32(levels.offset, TiledTexelIndexAVX2(x1, y0, levels.rowPitch)), mask);
+	__m256i c01 = GatherTexelsAVX2(tex, _mm256_add_epi32(levels.offset, TiledTexelIndexAVX2(x0, y1, levels.rowPitch)), mask);
+	__m256i c11 = GatherTexelsAVX2(tex, _mm256_add_epi32(levels.offset, TiledTexelIndexAVX2(x1, y1, levels.rowPitch)), mask);
+	return LerpColorAVX2(LerpColorAVX2(c00, c10, tx), LerpColorAVX2(c01, c11, tx), ty);
+}
+
+// TextureSampler::SampleNearest of 8 lanes, each in its own level
+TARGET_AVX2 static inline __m256i SampleNearestAVX2(const TextureSampler& tex, __m256i level, __m256 u, __m256 v, __m256i mask)
+{
+	LevelsAVX2 levels = GetLevelsAVX2(tex, level);
+
+	__m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_cvtepi32_ps(levels.width)));
+	__m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_cvtepi32_ps(levels.height)));
+	tx = _mm256_min_epi32(tx, _mm256_sub_epi32(levels.width, _mm256_set1_epi32(1)));
+	ty = _mm256_min_epi32(ty, _mm256_sub_epi32(levels.height, _mm256_set1_epi32(1)));
+	__m256i texIndex = _mm256_add_epi32(levels.offset, TiledTexelIndexAVX2(tx, ty, levels.rowPitch));
+	return GatherTexelsAVX2(tex, texIndex, mask);
+}
+
+// Lowest of the 8 lanes
+TARGET_AVX2 static inline int MinLaneAVX2(__m256i value)
+{
+	__m128i m = _mm_min_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(m);
+}
+
+// Texels of the lanes in passMask / passBits, u and v not addressed yet. finestLevel keeps
+// the lowest level each lane wanted, before levels that aren't resident are clamped away
+template<TextureFilter filter>
+TARGET_AVX2 static inline __m256i SampleAVX2(const RasterTriangle& tri, __m256 u, __m256 v, __m256 invW, __m256i passMask, int passBits, __m256i& finestLevel)
+{
+	const TextureSampler& tex = *tri.texture;
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	__m256 footprint = zero;
+	if constexpr (filter != TextureFilter::Nearest)
+		footprint = TexelFootprintAVX2(tri, u, v, _mm256_div_ps(one, invW));
+
+	u = AddressAVX2(tex.address, u);
+	v = AddressAVX2(tex.address, v);
+
+	if constexpr (filter == TextureFilter::Nearest)
+	{
+		finestLevel = _mm256_setzero_si256();
+		if (tex.minLevel > 0) return SampleNearestAVX2(tex, _mm256_set1_epi32(tex.minLevel), u, v, passMask);
+
+		__m256i tx = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(float(tex.width))));
+		__m256i ty = _mm256_cvttps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(float(tex.height))));
+		tx = _mm256_min_epi32(_mm256_max_epi32(tx, _mm256_setzero_si256()), _mm256_set1_epi32(tex.widthMask));
+		ty = _mm256_min_epi32(_mm256_max_epi32(ty, _mm256_setzero_si256()), _mm256_set1_epi32(tex.heightMask));
+		__m256i texIndex = TiledTexelIndexAVX2(tx, ty, _mm256_set1_epi32(TiledRowPitch(tex.width)));
+		return GatherTexelsAVX2(tex, texIndex, passMask);
+	}
+	else if constexpr (filter == TextureFilter::NearestMip || filter == TextureFilter::Bilinear)
+	{
+		__m256i level = NearestMipLevelAVX2(footprint, tex.levelCount);
+		finestLevel = _mm256_min_epi32(finestLevel, _mm256_blendv_epi8(_mm256_set1_epi32(INT_MAX), level, passMask));
+		level = _mm256_max_epi32(level, _mm256_set1_epi32(tex.minLevel));
+
+		if constexpr (filter == TextureFilter::NearestMip)
+			return SampleNearestAVX2(tex, level, u, v, passMask);
+		else
+			return SampleBilinearAVX2(tex, level, u, v, passMask);
+	}
+	else
+	{
+		// The level and blend weight per lane, log2 has no SIMD version that gives the same bits
+		alignas(32) float laneFootprint[8];
+		alignas(32) int laneLevel[8] = {}, laneBlend[8] = {};
+		_mm256_store_ps(laneFootprint, footprint);
+
+		int finest = INT_MAX;
+		for (int bits = passBits; bits; bits &= bits - 1)
+		{
+			int lane = LowestBit(bits);
+			float lod = 0.5f * std::log2(laneFootprint[lane]);
+			lod = lod > 0.f ? std::min(lod, float(tex.levelCount - 1)) : 0.f; // Also catches NaN
+			finest = std::min(finest, int(lod));
+			lod = std::max(lod, float(tex.minLevel));
+			laneLevel[lane] = int(lod);
+			laneBlend[lane] = int((lod - float(laneLevel[lane])) * 256.f);
+			if (laneLevel[lane] + 1 >= tex.levelCount) laneBlend[lane] = 0;
+		}
+
+		finestLevel = _mm256_min_epi32(finestLevel, _mm256_set1_epi32(finest));
+
+		__m256i level = _mm256_load_si256(reinterpret_cast<const __m256i*>(laneLevel));
+		__m256i blend = _mm256_load_si256(reinterpret_cast<const __m256i*>(laneBlend));
+		__m256i color = SampleBilinearAVX2(tex, level, u, v, passMask);
+
+		// Lanes with blend 0 skip the second level, lerping with weight 0 keeps color as it is
+		__m256i blended = _mm256_andnot_si256(_mm256_cmpeq_epi32(blend, _mm256_setzero_si256()), passMask);
+		if (_mm256_testz_si256(blended, blended)) return color;
+		__m256i next = _mm256_min_epi32(_mm256_add_epi32(level, _mm256_set1_epi32(1)), _mm256_set1_epi32(tex.levelCount - 1));
+		return LerpColorAVX2(color, SampleBilinearAVX2(tex, next, u, v, blended), blend);
+	}
+}
+
+// Same algorithm as PlotTriangleScalar, 8 horizontally adjacent pixels per iteration.
+// Edge functions stay in 64 bit (two registers of 4 lanes per edge) and the attributes are
+// evaluated like there, so the pixels are exactly the ones of the scalar path.
+template<TextureFilter filter>
+TARGET_AVX2 void PlotTriangleAVX2(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY)
+{
+	int64_t px = int64_t(minX) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+	int64_t py = int64_t(minY) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+
+	int64_t row[3], stepY[3];
+	__m256i laneOffsetLo[3], laneOffsetHi[3], stepBlock[3];
+	for (int i = 0; i < 3; i++)
+	{
+		int64_t stepX = tri.A[i] * SUBPIXEL_STEPS;
+		row[i] = tri.A[i] * px + tri.B[i] * py + tri.C[i];
+		stepY[i] = tri.B[i] * SUBPIXEL_STEPS;
+		laneOffsetLo[i] = _mm256_setr_epi64x(0, stepX, stepX * 2, stepX * 3);
+		laneOffsetHi[i] = _mm256_setr_epi64x(stepX * 4, stepX * 5, stepX * 6, stepX * 7);
+		stepBlock[i] = _mm256_set1_epi64x(stepX * 8);
+	}
+
+	const __m256 laneIndex = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i laneBit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	const __m256 dInvZ = _mm256_set1_ps(tri.invZ.dx);
+	const __m256 dInvW = _mm256_set1_ps(tri.invW.dx);
+	const __m256 dUDivW = _mm256_set1_ps(tri.uDivW.dx);
+	const __m256 dVDivW = _mm256_set1_ps(tri.vDivW.dx);
+	const __m256 blockWidth = _mm256_set1_ps(8.f);
+
+	const __m256i opaque = _mm256_set1_epi32(int(0xFF000000));
+	__m256i finestLevel = _mm256_set1_epi32(INT_MAX); // For the texture feedback
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		__m256i e0Lo = _mm256_add_epi64(_mm256_set1_epi64x(row[0]), laneOffsetLo[0]);
+		__m256i e0Hi = _mm256_add_epi64(_mm256_set1_epi64x(row[0]), laneOffsetHi[0]);
+		__m256i e1Lo = _mm256_add_epi64(_mm256_set1_epi64x(row[1]), laneOffsetLo[1]);
+		__m256i e1Hi = _mm256_add_epi64(_mm256_set1_epi64x(row[1]), laneOffsetHi[1]);
+		__m256i e2Lo = _mm256_add_epi64(_mm256_set1_epi64x(row[2]), laneOffsetLo[2]);
+		__m256i e2Hi = _mm256_add_epi64(_mm256_set1_epi64x(row[2]), laneOffsetHi[2]);
+
+		// Row start plus dx times the distance to it, the scalar kernel does the same per pixel
+		float fx = minX + 0.5f, fy = y + 0.5f;
+		const __m256 invZStart = _mm256_set1_ps(tri.invZ.At(fx, fy));
+		const __m256 invWStart = _mm256_set1_ps(tri.invW.At(fx, fy));
+		const __m256 uDivWStart = _mm256_set1_ps(tri.uDivW.At(fx, fy));
+		const __m256 vDivWStart = _mm256_set1_ps(tri.vDivW.At(fx, fy));
+		__m256 offset = laneIndex;
+
+		for (int x = minX; x <= maxX; x += 8)
+		{
+			// Sign bit of e0 | e1 | e2 is set for every pixel outside of at least one edge
+			__m256i outLo = _mm256_or_si256(_mm256_or_si256(e0Lo, e1Lo), e2Lo);
+			__m256i outHi = _mm256_or_si256(_mm256_or_si256(e0Hi, e1Hi), e2Hi);
+			int outside = _mm256_movemask_pd(_mm256_castsi256_pd(outLo)) | (_mm256_movemask_pd(_mm256_castsi256_pd(outHi)) << 4);
+
+			int remaining = maxX - x + 1;
+			int inRow = remaining >= 8 ? 0xFF : (1 << remaining) - 1;
+			int covered = ~outside & inRow;
+
+			if (covered)
+			{
+				__m256i coverMask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(covered), laneBit), laneBit);
+
+				__m256 invZ = _mm256_add_ps(invZStart, _mm256_mul_ps(dInvZ, offset));
+				__m256 z = _mm256_div_ps(one, invZ);
+
+				float* depth = target.depthBuffer + y * target.width + x;
+				__m256 stored = _mm256_maskload_ps(depth, coverMask);
+				__m256 pass = _mm256_and_ps(_mm256_cmp_ps(z, stored, _CMP_LT_OQ), _mm256_castsi256_ps(coverMask));
+				int passBits = _mm256_movemask_ps(pass);
+
+				if (passBits)
+				{
+					__m256i passMask = _mm256_castps_si256(pass);
+					_mm256_maskstore_ps(depth, passMask, z);
+
+					__m256 invW = _mm256_add_ps(invWStart, _mm256_mul_ps(dInvW, offset));
+					__m256 u = _mm256_div_ps(_mm256_add_ps(uDivWStart, _mm256_mul_ps(dUDivW, offset)), invW);
+					__m256 v = _mm256_div_ps(_mm256_add_ps(vDivWStart, _mm256_mul_ps(dVDivW, offset)), invW);
+					__m256i colors = _mm256_or_si256(SampleAVX2<filter>(tri, u, v, invW, passMask, passBits, finestLevel), opaque);
+
+					_mm256_maskstore_epi32(reinterpret_cast<int*>(target.framebuffer + y * target.width + x), passMask, colors);
+				}
+			}
+
+			e0Lo = _mm256_add_epi64(e0Lo, stepBlock[0]); e0Hi = _mm256_add_epi64(e0Hi, stepBlock[0]);
+			e1Lo = _mm256_add_epi64(e1Lo, stepBlock[1]); e1Hi = _mm256_add_epi64(e1Hi, stepBlock[1]);
+			e2Lo = _mm256_add_epi64(e2Lo, stepBlock[2]); e2Hi = _mm256_add_epi64(e2Hi, stepBlock[2]);
+			offset = _mm256_add_ps(offset, blockWidth);
+		}
+
+		row[0] += stepY[0]; row[1] += stepY[1]; row[2] += stepY[2];
+	}
+
+	if (tri.texture->feedback)
+	{
+		int finest = MinLaneAVX2(finestLevel);
+		if (finest != INT_MAX) tri.texture->feedback->Record(finest);
+	}
+}
+
+template void PlotTriangleAVX2<TextureFilter::Nearest>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX2<TextureFilter::NearestMip>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX2<TextureFilter::Bilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX2<TextureFilter::Trilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+#endif
@@ -0,0 +1,370 @@
+#include "RasterizerKernels.hpp"
+
+#ifdef RASTERIZER_X64
+#include <immintrin.h>
+#include <cmath>
+#include <cstddef>
+
+// Squared texel footprint of 16 pixels, see TexelFootprint
+TARGET_AVX512 static inline __m512 TexelFootprintAVX512(const RasterTriangle& tri, __m512 u, __m512 v, __m512 w)
+{
+	const TextureSampler& tex = *tri.texture;
+	__m512 texW = _mm512_set1_ps(float(tex.width)), texH = _mm512_set1_ps(float(tex.height));
+
+	__m512 dudx = _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(tri.uDivW.dx), _mm512_mul_ps(u, _mm512_set1_ps(tri.invW.dx))), w), texW);
+	__m512 dvdx = _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(tri.vDivW.dx), _mm512_mul_ps(v, _mm512_set1_ps(tri.invW.dx))), w), texH);
+	__m512 dudy = _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(tri.uDivW.dy), _mm512_mul_ps(u, _mm512_set1_ps(tri.invW.dy))), w), texW);
+	__m512 dvdy = _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(tri.vDivW.dy), _mm512_mul_ps(v, _mm512_set1_ps(tri.invW.dy))), w), texH);
+
+	__m512 lengthX = _mm512_add_ps(_mm512_mul_ps(dudx, dudx), _mm512_mul_ps(dvdx, dvdx));
+	__m512 lengthY = _mm512_add_ps(_mm512_mul_ps(dudy, dudy), _mm512_mul_ps(dvdy, dvdy));
+	return _mm512_max_ps(lengthX, lengthY);
+}
+
+// TiledTexelIndex of 16 texels, rowPitch is TiledRowPitch of their level width
+TARGET_AVX512 static inline __m512i TiledTexelIndexAVX512(__m512i x, __m512i y, __m512i rowPitch)
+{
+	const __m512i mask = _mm512_set1_epi32(TEXTURE_TILE_SIZE - 1);
+	__m512i tileRow = _mm512_mullo_epi32(_mm512_srli_epi32(y, TEXTURE_TILE_SHIFT), rowPitch);
+	__m512i tileColumn = _mm512_slli_epi32(_mm512_andnot_si512(mask, x), TEXTURE_TILE_SHIFT);
+	__m512i inTile = _mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(y, mask), TEXTURE_TILE_SHIFT), _mm512_and_si512(x, mask));
+	return _mm512_add_epi32(_mm512_add_epi32(tileRow, tileColumn), inTile);
+}
+
+// TextureSampler::Address of 16 lanes. Clamp maps NaN to 0
+TARGET_AVX512 static inline __m512 AddressAVX512(TextureAddress address, __m512 u)
+{
+	const __m512 one = _mm512_set1_ps(1.f);
+	switch (address)
+	{
+	case TextureAddress::Wrap: return _mm512_sub_ps(u, _mm512_roundscale_ps(u, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+	case TextureAddress::Mirror:
+	{
+		const __m512 two = _mm512_set1_ps(2.f);
+		__m512 m = _mm512_sub_ps(u, _mm512_mul_ps(two, _mm512_roundscale_ps(_mm512_mul_ps(u, _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+		return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(m, one, _CMP_GT_OQ), m, _mm512_sub_ps(two, m));
+	}
+	default: return _mm512_min_ps(_mm512_max_ps(u, _mm512_setzero_ps()), one);
+	}
+}
+
+// TextureSampler::AddressPair of 16 lanes
+TARGET_AVX512 static inline void AddressPairAVX512(TextureAddress address, __m512i x, __m512i size, __m512i& x0, __m512i& x1)
+{
+	const __m512i minusOne = _mm512_set1_epi32(-1);
+	__m512i next = _mm512_sub_epi32(x, minusOne);
+	__m512i last = _mm512_add_epi32(size, minusOne);
+	if (address == TextureAddress::Wrap)
+	{
+		__mmask16 inside0 = _mm512_cmpgt_epi32_mask(x, minusOne) & _mm512_cmpgt_epi32_mask(size, x);
+		__mmask16 inside1 = _mm512_cmpgt_epi32_mask(next, minusOne) & _mm512_cmpgt_epi32_mask(size, next);
+		x0 = _mm512_mask_blend_epi32(inside0, last, x);
+		x1 = _mm512_maskz_mov_epi32(inside1, next);
+	}
+	else
+	{
+		x0 = _mm512_min_epi32(_mm512_max_epi32(x, _mm512_setzero_si512()), last);
+		x1 = _mm512_min_epi32(_mm512_max_epi32(next, _mm512_setzero_si512()), last);
+	}
+}
+
+// LerpColor of 16 lanes, t in [0, 256]
+TARGET_AVX512 static inline __m512i LerpColorAVX512(__m512i a, __m512i b, __m512i t)
+{
+	const __m512i mask = _mm512_set1_epi32(0x00FF00FF);
+	__m512i s = _mm512_sub_epi32(_mm512_set1_epi32(256), t);
+	__m512i rb = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_and_si512(a, mask), s), _mm512_mullo_epi32(_mm512_and_si512(b, mask), t));
+	__m512i ag = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(a, 8), mask), s), _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(b, 8), mask), t));
+	rb = _mm512_and_si512(_mm512_srli_epi32(rb, 8), mask);
+	ag = _mm512_and_si512(_mm512_srli_epi32(ag, 8), mask);
+	return _mm512_or_si512(rb, _mm512_slli_epi32(ag, 8));
+}
+
+// Lanes in mask whose entry of decodedBlocks holds another block
+TARGET_AVX512 static inline __mmask16 MissingBlocksAVX512(__m512i entry, __m512i block, __mmask16 mask)
+{
+	__m512i cached = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, entry, decodedBlocks, 1);
+	return _mm512_mask_cmpneq_epi32_mask(mask, cached, block);
+}
+
+// Texels at index (from the start of the chain) of the lanes in mask. Block compressed
+// textures are read from decodedBlocks, the blocks that aren't there are decoded first
+// with TextureSampler::GetBlock, so the texels are the ones the scalar kernel reads
+TARGET_AVX512 static inline __m512i GatherTexelsAVX512(const TextureSampler& tex, __m512i index, __mmask16 mask)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	if (!tex.blocks) return _mm512_mask_i32gather_epi32(zero, mask, index, tex.texels, 4);
+
+	// DecodedBlockSlot, entries are found by byte offset
+	const int* texels = reinterpret_cast<const int*>(decodedBlocks) + offsetof(DecodedBlock, texels) / 4;
+	__m512i block = _mm512_add_epi32(_mm512_set1_epi32(int(tex.firstBlock)), _mm512_srli_epi32(index, 4));
+	__m512i slot = _mm512_srli_epi32(_mm512_mullo_epi32(block, _mm512_set1_epi32(int(0x9E3779B1u))), 32 - DECODED_BLOCK_CACHE_BITS);
+	__m512i entry = _mm512_mullo_epi32(slot, _mm512_set1_epi32(sizeof(DecodedBlock)));
+	__m512i texel = _mm512_add_epi32(entry, _mm512_slli_epi32(_mm512_and_si512(index, _mm512_set1_epi32(15)), 2));
+
+	__mmask16 missing = MissingBlocksAVX512(entry, block, mask);
+	if (!missing) return _mm512_mask_i32gather_epi32(zero, mask, texel, texels, 1);
+
+	alignas(64) uint32_t laneIndex[16];
+	_mm512_store_si512(laneIndex, index);
+	for (uint32_t bits = missing; bits; bits &= bits - 1) tex.GetBlock(laneIndex[LowestBit(bits)] >> 4);
+
+	// Lanes can want different blocks that share an entry, those are read one at a time
+	missing = MissingBlocksAVX512(entry, block, mask);
+	__m512i colors = _mm512_mask_i32gather_epi32(zero, mask, texel, texels, 1);
+	if (!missing) return colors;
+
+	alignas(64) uint32_t laneColor[16];
+	_mm512_store_si512(laneColor, colors);
+	for (uint32_t bits = missing; bits; bits &= bits - 1)
+	{
+		int lane = LowestBit(bits);
+		laneColor[lane] = tex.GetBlock(laneIndex[lane] >> 4).texels[laneIndex[lane] & 15];
+	}
+	return _mm512_load_si512(laneColor);
+}
+
+// Size and position of the mip level of every lane. Level sizes halve down to 1, offsets
+// come from the level table (3 ints per MipLevel)
+struct LevelsAVX512
+{
+	__m512i width, height, offset, rowPitch;
+};
+
+TARGET_AVX512 static inline LevelsAVX512 GetLevelsAVX512(const TextureSampler& tex, __m512i level)
+{
+	const __m512i one = _mm512_set1_epi32(1);
+	const __m512i tileMask = _mm512_set1_epi32(TEXTURE_TILE_SIZE - 1);
+
+	LevelsAVX512 levels;
+	levels.width = _mm512_max_epi32(_mm512_srlv_epi32(_mm512_set1_epi32(tex.width), level), one);
+	levels.height = _mm512_max_epi32(_mm512_srlv_epi32(_mm512_set1_epi32(tex.height), level), one);
+	levels.offset = _mm512_i32gather_epi32(_mm512_mullo_epi32(level, _mm512_set1_epi32(3)), &tex.levels->offset, 4);
+	levels.rowPitch = _mm512_slli_epi32(_mm512_andnot_si512(tileMask, _mm512_add_epi32(levels.width, tileMask)), TEXTURE_TILE_SHIFT); // TiledRowPitch
+	return levels;
+}
+
+// Same as NearestMipLevel: the level comes from the float exponent of the footprint
+TARGET_AVX512 static inline __m512i NearestMipLevelAVX512(__m512 footprint, int levelCount)
+{
+	footprint = _mm512_min_ps(footprint, _mm512_set1_ps(1e30f)); // NaN turns into 1e30 as well
+	__m512i exponent = _mm512_sub_epi32(_mm512_and_si512(_mm512_srli_epi32(_mm512_castps_si512(footprint), 23), _mm512_set1_epi32(0xFF)), _mm512_set1_epi32(127));
+	__m512i level = _mm512_srai_epi32(_mm512_add_epi32(exponent, _mm512_set1_epi32(1)), 1);
+	return _mm512_min_epi32(_mm512_max_epi32(level, _mm512_setzero_si512()), _mm512_set1_epi32(levelCount - 1));
+}
+
+// TextureSampler::SampleBilinear of 16 lanes, each in its own level. Only lanes in mask are read
+TARGET_AVX512 static inline __m512i SampleBilinearAVX512(const TextureSampler& tex, __m512i level, __m512 u, __m512 v, __mmask16 mask)
+{
+	const __m512 half = _mm512_set1_ps(0.5f), steps = _mm512_set1_ps(256.f);
+	LevelsAVX512 levels = GetLevelsAVX512(tex, level);
+
+	__m512 x = _mm512_sub_ps(_mm512_mul_ps(u, _mm512_cvtepi32_ps(levels.width)), half);
+	__m512 y = _mm512_sub_ps(_mm512_mul_ps(v, _mm512_cvtepi32_ps(levels.height)), half);
+	__m512 fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	__m512 fy = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	__m512i tx = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_sub_ps(x, fx), steps));
+	__m512i ty = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_sub_ps(y, fy), steps));
+
+	__m512i x0, x1, y0, y1;
+	AddressPairAVX512(tex.address, _mm512_cvttps_epi32(fx), levels.width, x0, x1);
+	AddressPairAVX512(tex.address, _mm512_cvttps_epi32(fy), levels.height, y0, y1);
+
+	__m512i c00 = GatherTexelsAVX512(tex, _mm512_add_epi32(levels.offset, TiledTexelIndexAVX512(x0, y0, levels.rowPitch)), mask);
+	__m512i c10 = GatherTexelsAVX512(tex, _mm512_add_epi32(levels.offset, TiledTexelIndexAVX512(x1, y0, levels.rowPitch)), mask);
+	__m512i c01 = GatherTexelsAVX512(tex, _mm512_add_epi32(levels.offset, TiledTexelIndexAVX512(x0, y1, levels.rowPitch)), mask);
+	__m512i c11 = GatherTexelsAVX512(tex, _mm512_add_epi32(levels.offset, TiledTexelIndexAVX512(x1, y1, levels.rowPitch)), mask);
+	return LerpColorAVX512(LerpColorAVX512(c00, c10, tx), LerpColorAVX512(c01, c11, tx), ty);
+}
+
+// TextureSampler::SampleNearest of 16 lanes, each in its own level
+TARGET_AVX512 static inline __m512i SampleNearestAVX512(const TextureSampler& tex, __m512i level, __m512 u, __m512 v, __mmask16 mask)
+{
+	LevelsAVX512 levels = GetLevelsAVX512(tex, level);
+
+	__m512i tx = _mm512_cvttps_epi32(_mm512_mul_ps(u, _mm512_cvtepi32_ps(levels.width)));
+	__m512i ty = _mm512_cvttps_epi32(_mm512_mul_ps(v, _mm512_cvtepi32_ps(levels.height)));
+	tx = _mm512_min_epi32(tx, _mm512_sub_epi32(levels.width, _mm512_set1_epi32(1)));
+	ty = _mm512_min_epi32(ty, _mm512_sub_epi32(levels.height, _mm512_set1_epi32(1)));
+	__m512i texIndex = _mm512_add_epi32(levels.offset, TiledTexelIndexAVX512(tx, ty, levels.rowPitch));
+	return GatherTexelsAVX512(tex, texIndex, mask);
+}
+
+// Texels of the lanes in pass, u and v not addressed yet. finestLevel keeps the lowest
+// level each lane wanted, before levels that aren't resident are clamped away
+template<TextureFilter filter>
+TARGET_AVX512 static inline __m512i SampleAVX512(const RasterTriangle& tri, __m512 u, __m512 v, __m512 invW, __mmask16 pass, __m512i& finestLevel)
+{
+	const TextureSampler& tex = *tri.texture;
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps(1.f);
+
+	__m512 footprint = zero;
+	if constexpr (filter != TextureFilter::Nearest)
+		footprint = TexelFootprintAVX512(tri, u, v, _mm512_div_ps(one, invW));
+
+	u = AddressAVX512(tex.address, u);
+	v = AddressAVX512(tex.address, v);
+
+	if constexpr (filter == TextureFilter::Nearest)
+	{
+		finestLevel = _mm512_setzero_si512();
+		if (tex.minLevel > 0) return SampleNearestAVX512(tex, _mm512_set1_epi32(tex.minLevel), u, v, pass);
+
+		__m512i tx = _mm512_cvttps_epi32(_mm512_mul_ps(u, _mm512_set1_ps(float(tex.width))));
+		__m512i ty = _mm512_cvttps_epi32(_mm512_mul_ps(v, _mm512_set1_ps(float(tex.height))));
+		tx = _mm512_min_epi32(_mm512_max_epi32(tx, _mm512_setzero_si512()), _mm512_set1_epi32(tex.widthMask));
+		ty = _mm512_min_epi32(_mm512_max_epi32(ty, _mm512_setzero_si512()), _mm512_set1_epi32(tex.heightMask));
+		__m512i texIndex = TiledTexelIndexAVX512(tx, ty, _mm512_set1_epi32(TiledRowPitch(tex.width)));
+		return GatherTexelsAVX512(tex, texIndex, pass);
+	}
+	else if constexpr (filter == TextureFilter::NearestMip || filter == TextureFilter::Bilinear)
+	{
+		__m512i level = NearestMipLevelAVX512(footprint, tex.levelCount);
+		finestLevel = _mm512_mask_min_epi32(finestLevel, pass, finestLevel, level);
+		level = _mm512_max_epi32(level, _mm512_set1_epi32(tex.minLevel));
+
+		if constexpr (filter == TextureFilter::NearestMip)
+			return SampleNearestAVX512(tex, level, u, v, pass);
+		else
+			return SampleBilinearAVX512(tex, level, u, v, pass);
+	}
+	else
+	{
+		// The level and blend weight per lane, log2 has no SIMD version that gives the same bits
+		alignas(64) float laneFootprint[16];
+		alignas(64) int laneLevel[16] = {}, laneBlend[16] = {};
+		_mm512_store_ps(laneFootprint, footprint);
+
+		int finest = INT_MAX;
+		for (uint32_t bits = pass; bits; bits &= bits - 1)
+		{
+			int lane = LowestBit(bits);
+			float lod = 0.5f * std::log2(laneFootprint[lane]);
+			lod = lod > 0.f ? std::min(lod, float(tex.levelCount - 1)) : 0.f; // Also catches NaN
+			finest = std::min(finest, int(lod));
+			lod = std::max(lod, float(tex.minLevel));
+			laneLevel[lane] = int(lod);
+			laneBlend[lane] = int((lod - float(laneLevel[lane])) * 256.f);
+			if (laneLevel[lane] + 1 >= tex.levelCount) laneBlend[lane] = 0;
+		}
+
+		finestLevel = _mm512_min_epi32(finestLevel, _mm512_set1_epi32(finest));
+
+		__m512i level = _mm512_load_si512(laneLevel);
+		__m512i blend = _mm512_load_si512(laneBlend);
+		__m512i color = SampleBilinearAVX512(tex, level, u, v, pass);
+
+		// Lanes with blend 0 skip the second level, lerping with weight 0 keeps color as it is
+		__mmask16 blended = _mm512_mask_cmpneq_epi32_mask(pass, blend, _mm512_setzero_si512());
+		if (!blended) return color;
+		__m512i next = _mm512_min_epi32(_mm512_add_epi32(level, _mm512_set1_epi32(1)), _mm512_set1_epi32(tex.levelCount - 1));
+		return LerpColorAVX512(color, SampleBilinearAVX512(tex, next, u, v, blended), blend);
+	}
+}
+
+// AVX-512 version of PlotTriangleAVX2: 16 pixels per iteration, with the coverage and
+// depth results kept in opmask registers instead of vector masks.
+template<TextureFilter filter>
+TARGET_AVX512 void PlotTriangleAVX512(const RasterTriangle& tri, const RasterTarget& target, int minX, int minY, int maxX, int maxY)
+{
+	int64_t px = int64_t(minX) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+	int64_t py = int64_t(minY) * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+
+	const __m512i laneIndex64 = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int64_t row[3], stepY[3];
+	__m512i laneOffsetLo[3], laneOffsetHi[3], stepBlock[3];
+	for (int i = 0; i < 3; i++)
+	{
+		int64_t stepX = tri.A[i] * SUBPIXEL_STEPS;
+		row[i] = tri.A[i] * px + tri.B[i] * py + tri.C[i];
+		stepY[i] = tri.B[i] * SUBPIXEL_STEPS;
+		laneOffsetLo[i] = _mm512_mullo_epi64(laneIndex64, _mm512_set1_epi64(stepX));
+		laneOffsetHi[i] = _mm512_add_epi64(laneOffsetLo[i], _mm512_set1_epi64(stepX * 8));
+		stepBlock[i] = _mm512_set1_epi64(stepX * 16);
+	}
+
+	const __m512 laneIndex = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512i zero64 = _mm512_setzero_si512();
+	const __m512 one = _mm512_set1_ps(1.f);
+
+	const __m512 dInvZ = _mm512_set1_ps(tri.invZ.dx);
+	const __m512 dInvW = _mm512_set1_ps(tri.invW.dx);
+	const __m512 dUDivW = _mm512_set1_ps(tri.uDivW.dx);
+	const __m512 dVDivW = _mm512_set1_ps(tri.vDivW.dx);
+	const __m512 blockWidth = _mm512_set1_ps(16.f);
+
+	const __m512i opaque = _mm512_set1_epi32(int(0xFF000000));
+	__m512i finestLevel = _mm512_set1_epi32(INT_MAX); // For the texture feedback
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		__m512i e0Lo = _mm512_add_epi64(_mm512_set1_epi64(row[0]), laneOffsetLo[0]);
+		__m512i e0Hi = _mm512_add_epi64(_mm512_set1_epi64(row[0]), laneOffsetHi[0]);
+		__m512i e1Lo = _mm512_add_epi64(_mm512_set1_epi64(row[1]), laneOffsetLo[1]);
+		__m512i e1Hi = _mm512_add_epi64(_mm512_set1_epi64(row[1]), laneOffsetHi[1]);
+		__m512i e2Lo = _mm512_add_epi64(_mm512_set1_epi64(row[2]), laneOffsetLo[2]);
+		__m512i e2Hi = _mm512_add_epi64(_mm512_set1_epi64(row[2]), laneOffsetHi[2]);
+
+		// Row start plus dx times the distance to it, the scalar kernel does the same per pixel
+		float fx = minX + 0.5f, fy = y + 0.5f;
+		const __m512 invZStart = _mm512_set1_ps(tri.invZ.At(fx, fy));
+		const __m512 invWStart = _mm512_set1_ps(tri.invW.At(fx, fy));
+		const __m512 uDivWStart = _mm512_set1_ps(tri.uDivW.At(fx, fy));
+		const __m512 vDivWStart = _mm512_set1_ps(tri.vDivW.At(fx, fy));
+		__m512 offset = laneIndex;
+
+		for (int x = minX; x <= maxX; x += 16)
+		{
+			__m512i inLo = _mm512_or_si512(_mm512_or_si512(e0Lo, e1Lo), e2Lo);
+			__m512i inHi = _mm512_or_si512(_mm512_or_si512(e0Hi, e1Hi), e2Hi);
+			__mmask16 inside = static_cast<__mmask16>(_mm512_cmpge_epi64_mask(inLo, zero64) | (_mm512_cmpge_epi64_mask(inHi, zero64) << 8));
+
+			int remaining = maxX - x + 1;
+			__mmask16 inRow = static_cast<__mmask16>(remaining >= 16 ? 0xFFFF : (1u << remaining) - 1);
+			__mmask16 covered = inside & inRow;
+
+			if (covered)
+			{
+				__m512 invZ = _mm512_add_ps(invZStart, _mm512_mul_ps(dInvZ, offset));
+				__m512 z = _mm512_div_ps(one, invZ);
+
+				float* depth = target.depthBuffer + y * target.width + x;
+				__m512 stored = _mm512_maskz_loadu_ps(covered, depth);
+				__mmask16 pass = _mm512_mask_cmp_ps_mask(covered, z, stored, _CMP_LT_OQ);
+
+				if (pass)
+				{
+					_mm512_mask_storeu_ps(depth, pass, z);
+
+					__m512 invW = _mm512_add_ps(invWStart, _mm512_mul_ps(dInvW, offset));
+					__m512 u = _mm512_div_ps(_mm512_add_ps(uDivWStart, _mm512_mul_ps(dUDivW, offset)), invW);
+					__m512 v = _mm512_div_ps(_mm512_add_ps(vDivWStart, _mm512_mul_ps(dVDivW, offset)), invW);
+					__m512i colors = _mm512_or_si512(SampleAVX512<filter>(tri, u, v, invW, pass, finestLevel), opaque);
+
+					_mm512_mask_storeu_epi32(target.framebuffer + y * target.width + x, pass, colors);
+				}
+			}
+
+			e0Lo = _mm512_add_epi64(e0Lo, stepBlock[0]); e0Hi = _mm512_add_epi64(e0Hi, stepBlock[0]);
+			e1Lo = _mm512_add_epi64(e1Lo, stepBlock[1]); e1Hi = _mm512_add_epi64(e1Hi, stepBlock[1]);
+			e2Lo = _mm512_add_epi64(e2Lo, stepBlock[2]); e2Hi = _mm512_add_epi64(e2Hi, stepBlock[2]);
+			offset = _mm512_add_ps(offset, blockWidth);
+		}
+
+		row[0] += stepY[0]; row[1] += stepY[1]; row[2] += stepY[2];
+	}
+
+	if (tri.texture->feedback)
+	{
+		int finest = _mm512_reduce_min_epi32(finestLevel);
+		if (finest != INT_MAX) tri.texture->feedback->Record(finest);
+	}
+}
+
+template void PlotTriangleAVX512<TextureFilter::Nearest>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX512<TextureFilter::NearestMip>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX512<TextureFilter::Bilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+template void PlotTriangleAVX512<TextureFilter::Trilinear>(const RasterTriangle&, const RasterTarget&, int, int, int, int);
+#endif
@@ -0,0 +1,302 @@
+#include "SceneTracker.hpp"
+#include <cmath>
+#include <cstring>
+
+uint32_t SceneTracker::AddInstance(uint32_t blasIdx, tinybvh::BVHBase* blas, const tinybvh::BVH* packetBLAS)
+{
+	if (blases.size() <= blasIdx)
+	{
+		blases.resize(blasIdx + 1, nullptr);
+		packetBlases.resize(blasIdx + 1, nullptr);
+	}
+	blases[blasIdx] = blas;
+	packetBlases[blasIdx] = packetBLAS;
+
+	instances.push_back(tinybvh::BLASInstance(blasIdx));
+	dirty.push_back(0);
+	structureChanged = true;
+
+	return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void SceneTracker::RemoveInstance(uint32_t instanceIdx)
+{
+	instances[instanceIdx] = instances.back();
+	instances.pop_back();
+	dirty.pop_back();
+	structureChanged = true;
+}
+
+void SceneTracker::SetTransform(uint32_t instanceIdx, const mat4& transform)
+{
+	// tinybvh wants the transposed matrix
+	float transposed[16];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			transposed[i * 4 + j] = transform.m[j][i];
+
+	tinybvh::BLASInstance& instance = instances[instanceIdx];
+	if (memcmp(instance.transform, transposed, sizeof(transposed)) == 0) return;
+
+	memcpy(instance.transform, transposed, sizeof(transposed));
+	if (!dirty[instanceIdx])
+	{
+		dirty[instanceIdx] = 1;
+		dirtyInstances.push_back(instanceIdx);
+	}
+}
+
+TLASUpdate SceneTracker::Update()
+{
+	if (instances.empty()) return TLASUpdate::Skipped; // tinybvh can't build over nothing
+
+	if (structureChanged)
+	{
+		Rebuild();
+		return TLASUpdate::Rebuild;
+	}
+
+	if (dirtyInstances.empty()) return TLASUpdate::Skipped;
+
+	Refit();
+	if (tlas.SAHCost() > builtCost * maxRefitCost)
+	{
+		Rebuild();
+		return TLASUpdate::Rebuild;
+	}
+
+	return TLASUpdate::Refit;
+}
+
+void SceneTracker::Rebuild()
+{
+	// Build() also updates the inverse transform and world bounds of every instance
+	tlas.Build(instances.data(), GetInstanceCount(), blases.data(), static_cast<uint32_t>(blases.size()));
+	builtCost = tlas.SAHCost();
+
+	for (uint32_t instanceIdx : dirtyInstances) if (instanceIdx < dirty.size()) dirty[instanceIdx] = 0;
+	dirtyInstances.clear();
+	structureChanged = false;
+}
+
+// BVH::Refit only handles triangles. Only the moved instances get new world bounds, the
+// nodes are then refitted bottom up: children always sit behind their parent in the pool
+void SceneTracker::Refit()
+{
+	for (uint32_t instanceIdx : dirtyInstances)
+	{
+		tinybvh::BLASInstance& instance = instances[instanceIdx];
+		instance.Update(blases[instance.blasIdx]);
+		dirty[instanceIdx] = 0;
+	}
+	dirtyInstances.clear();
+
+	for (int32_t i = static_cast<int32_t>(tlas.usedNodes) - 1; i >= 0; i--)
+	{
+		if (i == 1) continue; // Unused, keeps the children of the root on one cache line
+
+		tinybvh::BVH::BVHNode& node = tlas.bvhNode[i];
+		tinybvh::bvhvec3 bmin(BVH_FAR), bmax(-BVH_FAR);
+
+		if (node.isLeaf())
+		{
+			for (uint32_t j = 0; j < node.triCount; j++)
+			{
+				const tinybvh::BLASInstance& instance = instances[tlas.primIdx[node.leftFirst + j]];
+				bmin = tinybvh::tinybvh_min(bmin, instance.aabbMin);
+				bmax = tinybvh::tinybvh_max(bmax, instance.aabbMax);
+			}
+		}
+		else
+		{
+			const tinybvh::BVH::BVHNode& left = tlas.bvhNode[node.leftFirst];
+			const tinybvh::BVH::BVHNode& right = tlas.bvhNode[node.leftFirst + 1];
+			bmin = tinybvh::tinybvh_min(left.aabbMin, right.aabbMin);
+			bmax = tinybvh::tinybvh_max(left.aabbMax, right.aabbMax);
+		}
+
+		node.aabbMin = bmin;
+		node.aabbMax = bmax;
+	}
+}
+
+using tinybvh::bvhvec3;
+
+// The planes through the camera and the corner rays of a packet, normals pointing out
+struct PacketFrustum
+{
+	bvhvec3 O;
+	bvhvec3 planes[4];
+	float d[4];
+	int sign[4][3]; // Per plane and axis, the float of a BVHNode that is its corner furthest along the normal
+
+	explicit PacketFrustum(const tinybvh::Ray* packet)
+	{
+		O = packet[0].O;
+		const bvhvec3 p0 = packet[0].O + packet[0].D, p1 = packet[51].O + packet[51].D;
+		const bvhvec3 p2 = packet[204].O + packet[204].D, p3 = packet[255].O + packet[255].D;
+		planes[0] = tinybvh::tinybvh_normalize(tinybvh::tinybvh_cross(p0 - O, p0 - p2)); // Left
+		planes[1] = tinybvh::tinybvh_normalize(tinybvh::tinybvh_cross(p3 - O, p3 - p1)); // Right
+		planes[2] = tinybvh::tinybvh_normalize(tinybvh::tinybvh_cross(p1 - O, p1 - p0)); // Top
+		planes[3] = tinybvh::tinybvh_normalize(tinybvh::tinybvh_cross(p2 - O, p2 - p3)); // Bottom
+		for (int i = 0; i < 4; i++)
+		{
+			d[i] = tinybvh::tinybvh_dot(O, planes[i]);
+			sign[i][0] = planes[i].x < 0 ? 4 : 0;
+			sign[i][1] = planes[i].y < 0 ? 5 : 1;
+			sign[i][2] = planes[i].z < 0 ? 6 : 2;
+		}
+	}
+
+	bool Outside(const tinybvh::BVH::BVHNode& node) const
+	{
+		const float* minmax = reinterpret_cast<const float*>(&node);
+		for (int i = 0; i < 4; i++)
+		{
+			bvhvec3 corner(minmax[sign[i][0]], minmax[sign[i][1]], minmax[sign[i][2]]);
+			if (tinybvh::tinybvh_dot(corner, planes[i]) > d[i]) return true;
+		}
+		return false;
+	}
+};
+
+// Narrows [first, last] down to the rays of the packet that hit node before their closest
+// hit. False when none do, distance is where the first of them enters it
+static bool PacketHitsNode(const tinybvh::Ray* packet, const PacketFrustum& frustum, const tinybvh::BVH::BVHNode& node, int& first, int& last, float& distance)
+{
+	const bvhvec3 o1 = node.aabbMin - frustum.O, o2 = node.aabbMax - frustum.O;
+	auto hits = [&](int i, float& tmin)
+		{
+			const bvhvec3 t1 = o1 * packet[i].rD, t2 = o2 * packet[i].rD;
+			tmin = tinybvh::tinybvh_max(tinybvh::tinybvh_max(tinybvh::tinybvh_min(t1.x, t2.x), tinybvh::tinybvh_min(t1.y, t2.y)), tinybvh::tinybvh_min(t1.z, t2.z));
+			float tmax = tinybvh::tinybvh_min(tinybvh::tinybvh_min(tinybvh::tinybvh_max(t1.x, t2.x), tinybvh::tinybvh_max(t1.y, t2.y)), tinybvh::tinybvh_max(t1.z, t2.z));
+			return tmax >= tmin && tmin < packet[i].hit.t && tmax >= 0;
+		};
+
+	// The first active ray hitting it is enough, then it is the whole range
+	if (hits(first, distance)) return true;
+	if (frustum.Outside(node)) return false;
+
+	float t;
+	for (; first <= last; first++) if (hits(first, distance)) break;
+	for (; last >= first; last--) if (hits(last, t)) break;
+	return first <= last;
+}
+
+// The traversal of tinybvh's Intersect256Rays for any BVH: children are visited near to far
+// with the rays that can hit them, leaf(node, first, last) handles the leaves
+template<typename Leaf>
+static void TraversePacket(const tinybvh::BVH& bvh, const tinybvh::Ray* packet, const PacketFrustum& frustum, int first, int last, Leaf&& leaf)
+{
+	const tinybvh::BVH::BVHNode* node = &bvh.bvhNode[0];
+	uint32_t stack[128], stackPtr = 0; // Node and range pairs
+	while (true)
+	{
+		if (node->isLeaf())
+		{
+			leaf(*node, first, last);
+			if (stackPtr == 0) return;
+			last = stack[--stackPtr], node = bvh.bvhNode + stack[--stackPtr];
+			first = last >> 8, last &= 255;
+			continue;
+		}
+
+		const tinybvh::BVH::BVHNode* left = bvh.bvhNode + node->leftFirst;
+		const tinybvh::BVH::BVHNode* right = left + 1;
+		int leftFirst = first, leftLast = last, rightFirst = first, rightLast = last;
+		float distLeft, distRight;
+		bool visitLeft = PacketHitsNode(packet, frustum, *left, leftFirst, leftLast, distLeft);
+		bool visitRight = PacketHitsNode(packet, frustum, *right, rightFirst, rightLast, distRight);
+
+		if (visitLeft && visitRight)
+		{
+			if (distLeft < distRight)
+			{
+				stack[stackPtr++] = node->leftFirst + 1;
+				stack[stackPtr++] = (rightFirst << 8) + rightLast;
+				node = left, first = leftFirst, last = leftLast;
+			}
+			else
+			{
+				stack[stackPtr++] = node->leftFirst;
+				stack[stackPtr++] = (leftFirst << 8) + leftLast;
+				node = right, first = rightFirst, last = rightLast;
+			}
+		}
+		else if (visitLeft) node = left, first = leftFirst, last = leftLast;
+		else if (visitRight) node = right, first = rightFirst, last = rightLast;
+		else
+		{
+			if (stackPtr == 0) return;
+			last = stack[--stackPtr], node = bvh.bvhNode + stack[--stackPtr];
+			first = last >> 8, last &= 255;
+		}
+	}
+}
+
+// Rays [first, last] of a packet against a BVH over indexed triangles, which tinybvh's
+// Intersect256Rays can't read
+static void IntersectPacketBLAS(const tinybvh::BVH& blas, tinybvh::Ray* packet, int first, int last, uint32_t instIdx)
+{
+	PacketFrustum frustum(packet);
+	TraversePacket(blas, packet, frustum, first, last, [&](const tinybvh::BVH::BVHNode& node, int first, int last)
+		{
+			for (uint32_t j = 0; j < node.triCount; j++)
+			{
+				const uint32_t idx = blas.primIdx[node.leftFirst + j];
+				const bvhvec3 v0 = blas.verts[blas.vertIdx[idx * 3]];
+				const bvhvec3 edge1 = bvhvec3(blas.verts[blas.vertIdx[idx * 3 + 1]]) - v0, edge2 = bvhvec3(blas.verts[blas.vertIdx[idx * 3 + 2]]) - v0;
+				const bvhvec3 s = frustum.O - v0;
+				for (int i = first; i <= last; i++)
+				{
+					tinybvh::Ray& ray = packet[i];
+					const bvhvec3 h = tinybvh::tinybvh_cross(ray.D, edge2);
+					const float a = tinybvh::tinybvh_dot(edge1, h);
+					if (fabsf(a) < 0.0000001f) continue; // Parallel to the triangle
+					const float f = 1 / a, u = f * tinybvh::tinybvh_dot(s, h);
+					if (u < 0 || u > 1) continue;
+					const bvhvec3 q = tinybvh::tinybvh_cross(s, edge1);
+					const float v = f * tinybvh::tinybvh_dot(ray.D, q);
+					if (v < 0 || u + v > 1) continue;
+					const float t = f * tinybvh::tinybvh_dot(edge2, q);
+					if (t <= 0 || t >= ray.hit.t) continue;
+					ray.hit.t = t, ray.hit.u = u, ray.hit.v = v;
+					ray.hit.prim = idx;
+					ray.hit.inst = instIdx;
+				}
+			}
+		});
+}
+
+void SceneTracker::Intersect256Rays(tinybvh::Ray* packet) const
+{
+	if (instances.empty()) return;
+
+	// The TLAS leaves hold instances, their world bounds are the AABBs of the tree
+	PacketFrustum frustum(packet);
+	TraversePacket(tlas, packet, frustum, 0, 255, [&](const tinybvh::BVH::BVHNode& node, int first, int last)
+		{
+			tinybvh::Ray local[256];
+			for (uint32_t j = 0; j < node.triCount; j++)
+			{
+				const uint32_t instIdx = tlas.primIdx[node.leftFirst + j];
+				const tinybvh::BLASInstance& instance = instances[instIdx];
+				const tinybvh::BVH* blas = packetBlases[instance.blasIdx];
+				if (!blas) continue;
+
+				// The active rays and the corners the frustum is built from, into the space of the instance
+				auto toLocal = [&](int i)
+					{
+						local[i].O = tinybvh::tinybvh_transform_point(packet[i].O, instance.invTransform);
+						local[i].D = tinybvh::tinybvh_transform_vector(packet[i].D, instance.invTransform);
+						local[i].rD = tinybvh::tinybvh_safercp(local[i].D);
+						local[i].hit = packet[i].hit;
+					};
+				for (int i = first; i <= last; i++) toLocal(i);
+				for (int corner : { 0, 51, 204, 255 }) if (corner < first || corner > last) toLocal(corner);
+
+				IntersectPacketBLAS(*blas, local, first, last, instIdx);
+				for (int i = first; i <= last; i++) packet[i].hit = local[i].hit;
+			}
+		});
+}
@@ -1,4 +1,8 @@
 #include "Texture.hpp"
+#include "Logger.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstring>
 
 Texture::Texture(const std::string& filePath, const std::string& materialName)
 {
@@ -6,20 +10,458 @@ Texture::Texture(const std::string& filePath, const std::string& materialName)
 
     //stbi_set_flip_vertically_on_load(true); // optional but helps most renderers
 
-    buffer = stbi_load(filePath.c_str(), &width, &height, &nrChannels, 0);
-    if (!buffer) {
+    // Whatever the PNG has, convert to RGBA8 so every texture has the same layout
+    uint8_t* buffer = stbi_load(filePath.c_str(), &width, &height, &nrChannels, 4);
+    if (!buffer) 
+    {
+        Logger::Error("Cannot load texture " + filePath);
+        width = height = nrChannels = 0;
+        return;
+    }
+
+    texels.resize(size_t(width) * height);
+    for (size_t i = 0; i < texels.size(); i++)
+    {
+        const uint8_t* rgba = buffer + i * 4;
+        texels[i] = uint32_t(rgba[2]) | uint32_t(rgba[1]) << 8 | uint32_t(rgba[0]) << 16 | uint32_t(rgba[3]) << 24;
+    }
+
+    stbi_image_free(buffer);
+
+    GenerateMips();
+    TileLevels();
+}
+
+Texture::Texture(int width, int height, const uint32_t* texels, const std::string& materialName)
+    : name(materialName), width(width), height(height), nrChannels(4), texels(texels, texels + size_t(width) * height)
+{
+    GenerateMips();
+    TileLevels();
+}
+
+// Each level is a 2x2 box filter of the previous one, an odd last row / column is
+// folded into the texels next to it by clamping
+void Texture::GenerateMips()
+{
+    mips.clear();
+    mips.push_back({ 0, width, height });
+
+    while (mips.back().width > 1 || mips.back().height > 1)
+    {
+        MipLevel src = mips.back();
+        MipLevel dst = { src.offset + src.width * src.height, std::max(1, src.width >> 1), std::max(1, src.height >> 1) };
+        texels.resize(size_t(dst.offset) + size_t(dst.width) * dst.height);
+
+        for (int y = 0; y < dst.height; y++)
+        {
+            int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++)
+            {
+                int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                uint32_t a = texels[src.offset + y0 * src.width + x0];
+                uint32_t b = texels[src.offset + y0 * src.width + x1];
+                uint32_t c = texels[src.offset + y1 * src.width + x0];
+                uint32_t d = texels[src.offset + y1 * src.width + x1];
+
+                uint32_t result = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    uint32_t sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+                    result |= ((sum + 2) / 4) << shift;
+                }
+                texels[dst.offset + y * dst.width + x] = result;
+            }
+        }
+
+        mips.push_back(dst);
     }
 }
 
+// The mip chain is generated row major, then every level is copied into its tiles
+void Texture::TileLevels()
+{
+    std::vector<MipLevel> tiledMips;
+    int offset = 0;
+    for (const MipLevel& mip : mips)
+    {
+        tiledMips.push_back({ offset, mip.width, mip.height });
+        offset += TiledLevelSize(mip.width, mip.height);
+    }
+
+    std::vector<uint32_t, CacheLineAllocator<uint32_t>> tiled(offset, 0);
+    for (size_t level = 0; level < mips.size(); level++)
+    {
+        const MipLevel& src = mips[level];
+        const MipLevel& dst = tiledMips[level];
+        for (int y = 0; y < src.height; y++)
+            for (int x = 0; x < src.width; x++)
+                tiled[dst.offset + TiledTexelIndex(x, y, dst.width)] = texels[src.offset + y * src.width + x];
+    }
+
+    texels = std::move(tiled);
+    mips = std::move(tiledMips);
+}
+
 Texture::~Texture()
 {
 }
 
+// 5:6:5 color of an 0xAARRGGBB texel, rounded
+static uint16_t To565(uint32_t color)
+{
+    uint32_t r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF;
+    return uint16_t(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+// Back to 0xFFRRGGBB, the high bits are repeated into the low ones
+static uint32_t From565(uint16_t color)
+{
+    uint32_t r = (color >> 11) & 0x1F, g = (color >> 5) & 0x3F, b = color & 0x1F;
+    return 0xFF000000 | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+}
+
+// (a * weightA + b * weightB) / (weightA + weightB) on the color channels, opaque
+static uint32_t MixColor(uint32_t a, uint32_t b, uint32_t weightA, uint32_t weightB)
+{
+    uint32_t result = 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8)
+        result |= ((((a >> shift) & 0xFF) * weightA + ((b >> shift) & 0xFF) * weightB) / (weightA + weightB)) << shift;
+    return result;
+}
+
+// The four colors of a color block. BC1 blocks with c0 <= c1 have the average and
+// transparent black as the last two, BC3 color blocks always interpolate
+static void ColorPalette(uint64_t block, bool bc1, uint32_t palette[4])
+{
+    uint16_t c0 = uint16_t(block), c1 = uint16_t(block >> 16);
+    palette[0] = From565(c0);
+    palette[1] = From565(c1);
+    if (c0 > c1 || !bc1)
+    {
+        palette[2] = MixColor(palette[0], palette[1], 2, 1);
+        palette[3] = MixColor(palette[0], palette[1], 1, 2);
+    }
+    else
+    {
+        palette[2] = MixColor(palette[0], palette[1], 1, 1);
+        palette[3] = 0;
+    }
+}
+
+// The eight alphas of a BC3 alpha block
+static void AlphaPalette(uint64_t block, uint32_t palette[8])
+{
+    uint32_t a0 = uint32_t(block & 0xFF), a1 = uint32_t((block >> 8) & 0xFF);
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (uint32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static int ColorDistance(uint32_t a, uint32_t b)
+{
+    int dr = int((a >> 16) & 0xFF) - int((b >> 16) & 0xFF);
+    int dg = int((a >> 8) & 0xFF) - int((b >> 8) & 0xFF);
+    int db = int(a & 0xFF) - int(b & 0xFF);
+    return dr * dr + dg * dg + db * db;
+}
+
+// Endpoints are the two texels furthest apart along the main axis of the block's colors
+// (a few power iterations on the covariance), every texel takes the closest palette color
+static uint64_t EncodeColorBlock(const uint32_t texels[16])
+{
+    float colors[16][3], mean[3] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        colors[i][0] = float((texels[i] >> 16) & 0xFF);
+        colors[i][1] = float((texels[i] >> 8) & 0xFF);
+        colors[i][2] = float(texels[i] & 0xFF);
+        for (int c = 0; c < 3; c++) mean[c] += colors[i][c] / 16.f;
+    }
+
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < 3; a++)
+            for (int b = 0; b < 3; b++)
+                covariance[a][b] += (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+
+    float axis[3] = { 1.f, 1.f, 1.f };
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[3];
+        for (int a = 0; a < 3; a++) next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        float length = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (length == 0.f) break; // All texels the same color
+        for (int a = 0; a < 3; a++) axis[a] = next[a] / length;
+    }
+
+    int minIndex = 0, maxIndex = 0;
+    float minProjection = 0.f, maxProjection = 0.f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (colors[i][0] - mean[0]) * axis[0] + (colors[i][1] - mean[1]) * axis[1] + (colors[i][2] - mean[2]) * axis[2];
+        if (i == 0 || projection < minProjection) { minProjection = projection; minIndex = i; }
+        if (i == 0 || projection > maxProjection) { maxProjection = projection; maxIndex = i; }
+    }
+
+    // c0 > c1 picks the four color mode, c0 == c1 is one color and every index 0
+    uint16_t c0 = To565(texels[maxIndex]), c1 = To565(texels[minIndex]);
+    if (c0 < c1) std::swap(c0, c1);
+    uint64_t block = uint64_t(c0) | uint64_t(c1) << 16;
+    if (c0 == c1) return block;
+
+    uint32_t palette[4];
+    ColorPalette(block, false, palette);
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        for (int p = 1; p < 4; p++)
+            if (ColorDistance(texels[i], palette[p]) < ColorDistance(texels[i], palette[best])) best = p;
+        block |= uint64_t(best) << (32 + 2 * i);
+    }
+    return block;
+}
+
+// Endpoints are the lowest and highest alpha, in the eight alpha mode
+static uint64_t EncodeAlphaBlock(const uint32_t texels[16])
+{
+    uint32_t a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        a0 = std::max(a0, texels[i] >> 24);
+        a1 = std::min(a1, texels[i] >> 24);
+    }
+
+    uint64_t block = uint64_t(a0) | uint64_t(a1) << 8;
+    if (a0 == a1) return block;
+
+    uint32_t palette[8];
+    AlphaPalette(block, palette);
+    for (int i = 0; i < 16; i++)
+    {
+        uint32_t alpha = texels[i] >> 24;
+        int best = 0;
+        for (int p = 1; p < 8; p++)
+            if (std::abs(int(alpha) - int(palette[p])) < std::abs(int(alpha) - int(palette[best]))) best = p;
+        block |= uint64_t(best) << (16 + 3 * i);
+    }
+    return block;
+}
+
+// The 16 texels of a block, row major
+static void DecodeBlock(const uint64_t* block, TextureFormat format, uint32_t texels[16])
+{
+    uint64_t color = format == TextureFormat::BC3 ? block[1] : block[0];
+    uint32_t palette[4];
+    ColorPalette(color, format == TextureFormat::BC1, palette);
+    for (int i = 0; i < 16; i++) texels[i] = palette[(color >> (32 + 2 * i)) & 3];
+
+    if (format != TextureFormat::BC3) return;
+
+    uint32_t alphas[8];
+    AlphaPalette(block[0], alphas);
+    for (int i = 0; i < 16; i++) texels[i] = (texels[i] & 0x00FFFFFF) | alphas[(block[0] >> (16 + 3 * i)) & 7] << 24;
+}
+
+// Only new textures take numbers, streamed levels are loaded again under the numbers they had
+// (see TextureStreamer::RequestLoad). Wraps after 4 billion blocks of textures loaded
+static std::atomic<uint32_t> nextBlock{ 1 };
+
+void Texture::Compress(uint32_t blockNumber)
+{
+    if (texels.empty()) return;
+
+    // Padding texels are 0, only the ones inside a level count
+    bool opaque = true;
+    for (const MipLevel& mip : mips)
+        for (int y = 0; y < mip.height; y++)
+            for (int x = 0; x < mip.width; x++)
+                opaque &= (texels[mip.offset + TiledTexelIndex(x, y, mip.width)] >> 24) == 0xFF;
+
+    format = opaque ? TextureFormat::BC1 : TextureFormat::BC3;
+    const size_t words = opaque ? 1 : 2;
+
+    // Every tile turns into one block, levels start at a whole tile so block i is tile i of the chain
+    blocks.assign((texels.size() >> 4) * words, 0);
+    for (const MipLevel& src : mips)
+    {
+        int blocksWide = (src.width + TEXTURE_TILE_SIZE - 1) >> TEXTURE_TILE_SHIFT;
+        int blocksHigh = (src.height + TEXTURE_TILE_SIZE - 1) >> TEXTURE_TILE_SHIFT;
+
+        for (int by = 0; by < blocksHigh; by++)
+        {
+            for (int bx = 0; bx < blocksWide; bx++)
+            {
+                // Texels past the edge of the level repeat the edge, so they don't pull the endpoints away
+                uint32_t block[16];
+                for (int ty = 0; ty < 4; ty++)
+                {
+                    for (int tx = 0; tx < 4; tx++)
+                    {
+                        int x = std::min(bx * 4 + tx, src.width - 1), y = std::min(by * 4 + ty, src.height - 1);
+                        block[ty * 4 + tx] = texels[src.offset + TiledTexelIndex(x, y, src.width)];
+                    }
+                }
+
+                uint64_t* out = &blocks[((src.offset + TiledTexelIndex(bx * 4, by * 4, src.width)) >> 4) * words];
+                if (!opaque) *out++ = EncodeAlphaBlock(block);
+                *out = EncodeColorBlock(block);
+            }
+        }
+    }
+
+    firstBlock = blockNumber ? blockNumber : nextBlock.fetch_add(uint32_t(texels.size() >> 4), std::memory_order_relaxed);
+    texels.clear();
+    texels.shrink_to_fit();
+}
+
+void Texture::DropLevels(int level)
+{
+    level = std::min(level, static_cast<int>(mips.size()) - 1);
+    if (level <= residentLevel) return;
+
+    // Copied instead of erased, so the memory goes back
+    int first = mips[level].offset;
+    size_t bytes = GetMemorySize();
+    if (format != TextureFormat::RGBA8)
+    {
+        size_t words = format == TextureFormat::BC3 ? 2 : 1;
+        const uint64_t* data = static_cast<const uint64_t*>(GetData());
+        blocks = std::vector<uint64_t, CacheLineAllocator<uint64_t>>(data + (first >> 4) * words, data + bytes / sizeof(uint64_t));
+        firstBlock += uint32_t(first >> 4); // Same numbers for the same blocks, decoded ones stay valid
+    }
+    else
+    {
+        const uint32_t* data = static_cast<const uint32_t*>(GetData());
+        texels = std::vector<uint32_t, CacheLineAllocator<uint32_t>>(data + first, data + bytes / sizeof(uint32_t));
+    }
+
+    packed = nullptr;
+    for (MipLevel& mip : mips) mip.offset -= first;
+    residentLevel = level;
+}
+
+void Texture::MoveTo(void* dest)
+{
+    if (!IsValid()) return;
+
+    memcpy(dest, GetData(), GetMemorySize());
+    packed = dest;
+    texels.clear();
+    texels.shrink_to_fit();
+    blocks.clear();
+    blocks.shrink_to_fit();
+}
+
+const void* Texture::GetData() const
+{
+    if (packed) return packed;
+    if (format != TextureFormat::RGBA8) return blocks.data();
+    return texels.data();
+}
+
+size_t Texture::GetMemorySize(int level) const
+{
+    if (mips.empty()) return 0;
+
+    const MipLevel& last = mips.back();
+    size_t texelCount = size_t(last.offset + TiledLevelSize(last.width, last.height) - mips[level].offset);
+    switch (format)
+    {
+    case TextureFormat::BC1: return texelCount / 2; // 8 bytes per 16 texels
+    case TextureFormat::BC3: return texelCount;
+    default: return texelCount * sizeof(uint32_t);
+    }
+}
+
 uint8_t Texture::GetTexel(int x, int y, int channel) const
 {
-    if (!buffer || x < 0 || y < 0 || x >= width || y >= height || channel >= nrChannels)
+    if (!IsValid() || x < 0 || y < 0 || x >= width || y >= height || channel < 0 || channel > 3)
         return 0;
 
-    int index = (y * width + x) * nrChannels + channel;
-    return buffer[index];
-}
\ No newline at end of file
+    // Channel 0..3 = R, G, B, A. Dropped levels read the texel covering x, y in the finest resident one
+    static const int shifts[4] = { 16, 8, 0, 24 };
+    return static_cast<uint8_t>(GetSampler().Fetch(residentLevel, x >> residentLevel, y >> residentLevel) >> shifts[channel]);
+}
+
+TextureSampler Texture::GetSampler() const
+{
+    if (!IsValid()) return GetDefault().GetSampler();
+
+    TextureSampler sampler;
+    bool compressed = format != TextureFormat::RGBA8;
+    sampler.texels = compressed ? nullptr : static_cast<const uint32_t*>(GetData());
+    sampler.blocks = compressed ? static_cast<const uint64_t*>(GetData()) : nullptr;
+    sampler.format = format;
+    sampler.firstBlock = firstBlock;
+    sampler.width = width;
+    sampler.height = height;
+    sampler.widthMask = width - 1;
+    sampler.heightMask = height - 1;
+    sampler.levels = mips.data();
+    sampler.levelCount = static_cast<int>(mips.size());
+    sampler.minLevel = residentLevel;
+    sampler.feedback = feedback;
+    sampler.address = address;
+    return sampler;
+}
+
+void TextureSampler::Decode(uint32_t block, DecodedBlock& entry) const
+{
+    const uint64_t* data = blocks + size_t(block) * (format == TextureFormat::BC3 ? 2 : 1);
+#ifdef MEASURE_TEXTURE_CACHE
+    TextureCacheModel::Read(data);
+#endif
+    DecodeBlock(data, format, entry.texels);
+    entry.block = firstBlock + block;
+}
+
+// a + (b - a) * t / 256 on all four channels at once, t in [0, 256]
+static uint32_t LerpColor(uint32_t a, uint32_t b, uint32_t t)
+{
+    uint32_t rb = (((a & 0x00FF00FF) * (256 - t) + (b & 0x00FF00FF) * t) >> 8) & 0x00FF00FF;
+    uint32_t ag = ((((a >> 8) & 0x00FF00FF) * (256 - t) + ((b >> 8) & 0x00FF00FF) * t) >> 8) & 0x00FF00FF;
+    return rb | (ag << 8);
+}
+
+uint32_t TextureSampler::SampleBilinear(float u, float v, int level) const
+{
+    const MipLevel& mip = levels[level];
+    float x = u * float(mip.width) - 0.5f;
+    float y = v * float(mip.height) - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    uint32_t tx = uint32_t((x - fx) * 256.f), ty = uint32_t((y - fy) * 256.f);
+
+    int x0, x1, y0, y1;
+    AddressPair(int(fx), mip.width, x0, x1);
+    AddressPair(int(fy), mip.height, y0, y1);
+
+    return LerpColor(LerpColor(Fetch(level, x0, y0), Fetch(level, x1, y0), tx), LerpColor(Fetch(level, x0, y1), Fetch(level, x1, y1), tx), ty);
+}
+
+uint32_t TextureSampler::SampleTrilinear(float u, float v, float lod) const
+{
+    lod = lod > 0.f ? std::min(lod, float(levelCount - 1)) : 0.f; // Also catches NaN
+    lod = std::max(lod, float(minLevel));
+    int level = int(lod);
+    uint32_t t = uint32_t((lod - float(level)) * 256.f);
+
+    uint32_t color = SampleBilinear(u, v, level);
+    if (t == 0 || level + 1 >= levelCount) return color;
+    return LerpColor(color, SampleBilinear(u, v, level + 1), t);
+}
+
+const Texture& Texture::GetDefault()
+{
+    static const uint32_t white = 0xFFFFFFFF;
+    static const Texture defaultTexture(1, 1, &white, "Default");
+    return defaultTexture;
+}
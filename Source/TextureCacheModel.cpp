@@ -0,0 +1,68 @@
+#include "TextureCacheModel.hpp"
+#include "Common.hpp"
+#include <atomic>
+
+#ifdef MEASURE_TEXTURE_CACHE
+namespace
+{
+	constexpr int LINE_BITS = 6;
+	constexpr int WAYS = 8;
+	constexpr int SETS = (32 << 10) / (1 << LINE_BITS) / WAYS;
+
+	// Line address + 1 per way, most recently used first, 0 is an empty way
+	struct Cache
+	{
+		uintptr_t lines[SETS][WAYS] = {};
+	};
+
+	thread_local Cache cache;
+	std::atomic<uint64_t> reads{ 0 }, misses{ 0 }, pixels{ 0 };
+}
+
+namespace TextureCacheModel
+{
+	void Read(const void* address)
+	{
+		uintptr_t line = (reinterpret_cast<uintptr_t>(address) >> LINE_BITS) + 1;
+		uintptr_t* set = cache.lines[line % SETS];
+		reads.fetch_add(1, std::memory_order_relaxed);
+
+		int way = 0;
+		while (way < WAYS && set[way] != line) way++;
+		if (way == WAYS)
+		{
+			misses.fetch_add(1, std::memory_order_relaxed);
+			way = WAYS - 1; // Evicts the least recently used
+		}
+
+		for (; way > 0; way--) set[way] = set[way - 1];
+		set[0] = line;
+	}
+
+	void CountPixel() { pixels.fetch_add(1, std::memory_order_relaxed); }
+
+	Counts GetCounts()
+	{
+		Counts counts;
+		counts.reads = reads.load(std::memory_order_relaxed);
+		counts.misses = misses.load(std::memory_order_relaxed);
+		counts.pixels = pixels.load(std::memory_order_relaxed);
+		return counts;
+	}
+
+	void Reset()
+	{
+		reads = 0;
+		misses = 0;
+		pixels = 0;
+	}
+}
+#else
+namespace TextureCacheModel
+{
+	void Read(const void*) {}
+	void CountPixel() {}
+	Counts GetCounts() { return Counts(); }
+	void Reset() {}
+}
+#endif
@@ -0,0 +1,150 @@
+#include "TextureStreamer.hpp"
+#include <algorithm>
+#include <climits>
+
+TextureStreamer::TextureStreamer(AssetLoader* loader, size_t budget)
+	: loader(loader), budget(budget), completed(std::make_shared<Completed>())
+{
+}
+
+void TextureStreamer::AddModel(Model* model)
+{
+	Mesh& mesh = model->mesh;
+	for (size_t i = 0; i < mesh.materials.size() && i < mesh.textures.size(); i++)
+	{
+		const std::string& file = mesh.materials[i].diffuseTexture;
+		Texture& texture = mesh.textures[i];
+		if (file.empty() || !texture.IsValid()) continue;
+
+		Entry& entry = entries.emplace_back();
+		entry.texture = &texture;
+		entry.filePath = model->textureDirectory + file;
+		entry.lastUsed = frame;
+		texture.feedback = &entry.feedback;
+		residentBytes += texture.GetMemorySize();
+	}
+}
+
+TextureStreamingStats TextureStreamer::Update()
+{
+	TextureStreamingStats stats;
+	frame++;
+
+	ApplyLoads(stats);
+
+	// What the kernels asked for last frame
+	for (Entry& entry : entries)
+	{
+		int level = entry.feedback.Reset();
+		if (level == INT_MAX) continue;
+
+		entry.lastUsed = frame;
+		entry.wantedLevel = std::min(level, static_cast<int>(entry.texture->mips.size()) - 1);
+	}
+
+	// Only new models push it over
+	MakeRoom(0, nullptr, true, stats);
+
+	// A level that doesn't fit is tried a level coarser
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		Entry& entry = entries[i];
+		if (entry.lastUsed != frame || entry.reserved) continue;
+
+		for (int level = entry.wantedLevel; level < entry.texture->residentLevel; level++)
+		{
+			size_t extra = entry.texture->GetMemorySize(level) - entry.texture->GetMemorySize(entry.texture->residentLevel);
+			if (!MakeRoom(extra, &entry, false, stats)) continue;
+
+			entry.reserved = extra;
+			reservedBytes += extra;
+			RequestLoad(i, level, stats);
+			break;
+		}
+	}
+
+	stats.residentBytes = residentBytes;
+	stats.budget = budget;
+	return stats;
+}
+
+void TextureStreamer::ApplyLoads(TextureStreamingStats& stats)
+{
+	{
+		std::lock_guard<std::mutex> lock(completed->mutex);
+		std::swap(applying, completed->loads);
+	}
+
+	for (auto& [index, loaded] : applying)
+	{
+		Entry& entry = entries[index];
+		Texture& texture = *entry.texture;
+		reservedBytes -= entry.reserved;
+		entry.reserved = 0;
+
+		// Anything that went wrong loading keeps the levels there are
+		if (!loaded.IsValid() || loaded.mips.size() != texture.mips.size() || loaded.residentLevel >= texture.residentLevel) continue;
+
+		residentBytes -= texture.GetMemorySize();
+		texture.format = loaded.format;
+		texture.texels = std::move(loaded.texels);
+		texture.blocks = std::move(loaded.blocks);
+		texture.packed = nullptr;
+		texture.firstBlock = loaded.firstBlock;
+		texture.mips = std::move(loaded.mips);
+		texture.residentLevel = loaded.residentLevel;
+		residentBytes += texture.GetMemorySize();
+		stats.loadsCompleted++;
+	}
+
+	applying.clear();
+}
+
+void TextureStreamer::RequestLoad(size_t index, int level, TextureStreamingStats& stats)
+{
+	stats.loadsRequested++;
+
+	// The file is decoded again and brought into the same format, then cut down to the levels that were asked for.
+	// Compressed blocks keep their numbers, mips[0].offset is where level 0 was before the dropped levels went
+	const Texture& resident = *entries[index].texture;
+	bool compress = resident.format != TextureFormat::RGBA8;
+	uint32_t firstBlock = compress ? resident.firstBlock - uint32_t(-resident.mips[0].offset >> 4) : 0;
+	loader->Enqueue([completed = completed, index, filePath = entries[index].filePath, compress, firstBlock, level]
+		{
+			Texture texture(filePath, filePath);
+			if (compress) texture.Compress(firstBlock);
+			texture.DropLevels(level);
+
+			std::lock_guard<std::mutex> lock(completed->mutex);
+			completed->loads.emplace_back(index, std::move(texture));
+		});
+}
+
+bool TextureStreamer::MakeRoom(size_t bytes, const Entry* skip, bool anyUsed, TextureStreamingStats& stats)
+{
+	while (residentBytes + reservedBytes + bytes > budget)
+	{
+		// Least recently used first, then the one whose finest level frees the most
+		Entry* victim = nullptr;
+		size_t victimBytes = 0;
+		for (Entry& entry : entries)
+		{
+			const Texture& texture = *entry.texture;
+			if (&entry == skip || entry.reserved || texture.residentLevel + 1 >= static_cast<int>(texture.mips.size())) continue;
+			if (entry.lastUsed == frame && !anyUsed && texture.residentLevel >= entry.wantedLevel) continue;
+
+			size_t freed = texture.GetMemorySize(texture.residentLevel) - texture.GetMemorySize(texture.residentLevel + 1);
+			if (!victim || entry.lastUsed < victim->lastUsed || (entry.lastUsed == victim->lastUsed && freed > victimBytes))
+			{
+				victim = &entry;
+				victimBytes = freed;
+			}
+		}
+		if (!victim) return false;
+
+		victim->texture->DropLevels(victim->texture->residentLevel + 1);
+		residentBytes -= victimBytes;
+		stats.levelsEvicted++;
+	}
+	return true;
+}
@@ -0,0 +1,176 @@
+#include "VertexTransform.hpp"
+#include "RasterizerKernels.hpp"
+#include <cassert>
+#include <cmath>
+
+#ifdef RASTERIZER_X64
+#include <immintrin.h>
+#endif
+
+void TransformedVertices::Allocate(ScratchRegion& scratch, size_t capacity)
+{
+	for (std::span<float>* stream : { &clipX, &clipY, &clipZ, &clipW, &screenX, &screenY, &depth, &invW, &uDivW, &vDivW })
+		*stream = scratch.AllocateArray<float>(capacity);
+	clipCode = scratch.AllocateArray<uint32_t>(capacity);
+	count = 0;
+}
+
+TransformedVertices TransformedVertices::Slice(size_t first, size_t size) const
+{
+	TransformedVertices slice;
+	slice.clipX = clipX.subspan(first, size);
+	slice.clipY = clipY.subspan(first, size);
+	slice.clipZ = clipZ.subspan(first, size);
+	slice.clipW = clipW.subspan(first, size);
+	slice.clipCode = clipCode.subspan(first, size);
+	slice.screenX = screenX.subspan(first, size);
+	slice.screenY = screenY.subspan(first, size);
+	slice.depth = depth.subspan(first, size);
+	slice.invW = invW.subspan(first, size);
+	slice.uDivW = uDivW.subspan(first, size);
+	slice.vDivW = vDivW.subspan(first, size);
+	return slice;
+}
+
+ScreenVertex ProjectToScreen(const float4& c, const float2& uv, int width, int height)
+{
+	if (std::abs(c.w) < 1e-5f) return { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+
+	float ndcX = c.x / c.w;
+	float ndcY = c.y / c.w;
+
+	ScreenVertex v;
+	v.x = (ndcX + 1.0f) * 0.5f * width;
+	v.y = (1.0f - (ndcY + 1.0f) * 0.5f) * height;
+	v.z = c.z / c.w; // NDC z for the depth buffer
+	v.invW = 1.0f / c.w;
+	v.uDivW = uv.x * v.invW;
+	v.vDivW = uv.y * v.invW;
+	return v;
+}
+
+static void TransformScalar(std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, const mat4& MV, const mat4& proj,
+	int width, int height, size_t first, TransformedVertices& out)
+{
+	for (size_t i = first; i < positions.size(); i++)
+	{
+		float4 view = float4{ positions[i].x, positions[i].y, positions[i].z, 1.f } * MV;
+		float4 c = float4{ view.x, view.y, view.z, 1.f } * proj;
+		out.clipX[i] = c.x;
+		out.clipY[i] = c.y;
+		out.clipZ[i] = c.z;
+		out.clipW[i] = c.w;
+		out.clipCode[i] = ComputeClipCode(c.x, c.y, c.z, c.w);
+
+		ScreenVertex v = ProjectToScreen(c, uvs[i], width, height);
+		out.screenX[i] = v.x;
+		out.screenY[i] = v.y;
+		out.depth[i] = v.z;
+		out.invW[i] = v.invW;
+		out.uDivW[i] = v.uDivW;
+		out.vDivW[i] = v.vDivW;
+	}
+}
+
+#ifdef RASTERIZER_X64
+// Column col of (x, y, z, 1) * M. Separate multiplies and adds in the scalar order, an FMA
+// would round differently
+TARGET_AVX2 static inline __m256 TransformColumn(__m256 x, __m256 y, __m256 z, const mat4& M, int col)
+{
+	__m256 sum = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(M.m[0][col])), _mm256_mul_ps(y, _mm256_set1_ps(M.m[1][col])));
+	sum = _mm256_add_ps(sum, _mm256_mul_ps(z, _mm256_set1_ps(M.m[2][col])));
+	return _mm256_add_ps(sum, _mm256_set1_ps(M.m[3][col]));
+}
+
+// 8 vertices per iteration, returns how many it did. The rest is left to the scalar version
+TARGET_AVX2 static size_t TransformAVX2(std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, const mat4& MV, const mat4& proj,
+	int width, int height, TransformedVertices& out)
+{
+	const __m256 one = _mm256_set1_ps(1.f), half = _mm256_set1_ps(0.5f);
+	const __m256 screenW = _mm256_set1_ps(float(width)), screenH = _mm256_set1_ps(float(height));
+	const __m256 minW = _mm256_set1_ps(1e-5f), absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(int(0x80000000))), zero = _mm256_setzero_ps();
+	const __m256 guardBand = _mm256_set1_ps(GUARD_BAND);
+
+	size_t i = 0;
+	for (; i + 8 <= positions.size(); i += 8)
+	{
+		// Vertices i..i+3 in the low lanes and i+4..i+7 in the high lanes, so the 4x4
+		// transpose in each lane puts x, y and z in vertex order
+		const float* p = reinterpret_cast<const float*>(positions.data() + i);
+		__m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 0)), _mm_loadu_ps(p + 16), 1);
+		__m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 20), 1);
+		__m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 24), 1);
+		__m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 12)), _mm_loadu_ps(p + 28), 1);
+		__m256 xy01 = _mm256_unpacklo_ps(r0, r1), xy23 = _mm256_unpacklo_ps(r2, r3);
+		__m256 zw01 = _mm256_unpackhi_ps(r0, r1), zw23 = _mm256_unpackhi_ps(r2, r3);
+		__m256 x = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 y = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 z = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+
+		__m256 viewX = TransformColumn(x, y, z, MV, 0);
+		__m256 viewY = TransformColumn(x, y, z, MV, 1);
+		__m256 viewZ = TransformColumn(x, y, z, MV, 2);
+
+		__m256 clipX = TransformColumn(viewX, viewY, viewZ, proj, 0);
+		__m256 clipY = TransformColumn(viewX, viewY, viewZ, proj, 1);
+		__m256 clipZ = TransformColumn(viewX, viewY, viewZ, proj, 2);
+		__m256 clipW = TransformColumn(viewX, viewY, viewZ, proj, 3);
+		__m256 valid = _mm256_cmp_ps(_mm256_and_ps(clipW, absMask), minW, _CMP_NLT_UQ);
+		_mm256_storeu_ps(&out.clipX[i], clipX);
+		_mm256_storeu_ps(&out.clipY[i], clipY);
+		_mm256_storeu_ps(&out.clipZ[i], clipZ);
+		_mm256_storeu_ps(&out.clipW[i], clipW);
+
+		// Outcodes, the same comparisons as ComputeClipCode
+		__m256 negW = _mm256_xor_ps(clipW, signMask);
+		__m256 guard = _mm256_mul_ps(guardBand, clipW), negGuard = _mm256_xor_ps(guard, signMask);
+		__m256i code = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, negW, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_LEFT));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, clipW, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_RIGHT)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, negW, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_BOTTOM)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, clipW, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_TOP)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipZ, zero, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_NEAR)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipZ, clipW, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_FAR)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, negGuard, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_GUARD_LEFT)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipX, guard, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_GUARD_RIGHT)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, negGuard, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_GUARD_BOTTOM)));
+		code = _mm256_or_si256(code, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipY, guard, _CMP_GT_OQ)), _mm256_set1_epi32(CLIP_GUARD_TOP)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.clipCode[i]), code);
+
+		// uv pairs the same way, 0 1 | 4 5 and 2 3 | 6 7
+		const float* t = reinterpret_cast<const float*>(uvs.data() + i);
+		__m256 uv0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(t + 0)), _mm_loadu_ps(t + 8), 1);
+		__m256 uv1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(t + 4)), _mm_loadu_ps(t + 12), 1);
+		__m256 u = _mm256_shuffle_ps(uv0, uv1, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 v = _mm256_shuffle_ps(uv0, uv1, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m256 ndcX = _mm256_div_ps(clipX, clipW);
+		__m256 ndcY = _mm256_div_ps(clipY, clipW);
+		__m256 invW = _mm256_div_ps(one, clipW);
+		__m256 screenX = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(ndcX, one), half), screenW);
+		__m256 screenY = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(_mm256_add_ps(ndcY, one), half)), screenH);
+
+		_mm256_storeu_ps(&out.screenX[i], _mm256_and_ps(screenX, valid));
+		_mm256_storeu_ps(&out.screenY[i], _mm256_and_ps(screenY, valid));
+		_mm256_storeu_ps(&out.depth[i], _mm256_and_ps(_mm256_div_ps(clipZ, clipW), valid));
+		_mm256_storeu_ps(&out.invW[i], _mm256_and_ps(invW, valid));
+		_mm256_storeu_ps(&out.uDivW[i], _mm256_and_ps(_mm256_mul_ps(u, invW), valid));
+		_mm256_storeu_ps(&out.vDivW[i], _mm256_and_ps(_mm256_mul_ps(v, invW), valid));
+	}
+
+	return i;
+}
+#endif
+
+void TransformVertices(std::span<const tinybvh::bvhvec4> positions, std::span<const float2> uvs, const mat4& MV, const mat4& proj,
+	int width, int height, bool useAVX2, TransformedVertices& out)
+{
+	assert(positions.size() <= out.clipX.size());
+	out.count = positions.size();
+
+	size_t done = 0;
+#ifdef RASTERIZER_X64
+	if (useAVX2) done = TransformAVX2(positions, uvs, MV, proj, width, height, out);
+#endif
+	TransformScalar(positions, uvs, MV, proj, width, height, done, out);
+}
@@ -1,17 +1,68 @@
 #include "Game.hpp"
+#include "PlatformHeadless.hpp"
+#include <cstring>
+#include <string>
 
+// Usage: Renderer [--headless] [--frames N] [--dump DIR] [--threads N] [--kernel auto|scalar|avx2|avx512] [--filter nearest|mip|bilinear|trilinear] [--trace-tile N] [--loader-threads N] [--textures bc|rgba8] [--texture-budget KB]
 int main(int argc, char* argv[])
 {
-    Program* game = new Game("Renderer");
+	PlatformType platformType = PlatformType::Default;
+	int frameLimit = 0;
+	std::string dumpDirectory;
+	uint32_t threadCount = 0;
+	RasterKernel rasterKernel = RasterKernel::Auto;
+	TextureFilter textureFilter = TextureFilter::NearestMip;
+	int traceTileSize = 16;
+	uint32_t loaderThreadCount = 0;
+	bool compressTextures = true;
+	size_t textureBudget = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0) platformType = PlatformType::Headless;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frameLimit = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) dumpDirectory = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threadCount = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) rasterKernel = Rasterizer::ParseKernelName(argv[++i]);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) textureFilter = Rasterizer::ParseTextureFilterName(argv[++i]);
+		else if (strcmp(argv[i], "--trace-tile") == 0 && i + 1 < argc) traceTileSize = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--loader-threads") == 0 && i + 1 < argc) loaderThreadCount = std::atoi(argv[++i]);
+		else if (strcmp(argv[i], "--textures") == 0 && i + 1 < argc) compressTextures = strcmp(argv[++i], "rgba8") != 0;
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) textureBudget = size_t(std::max(0, std::atoi(argv[++i]))) * 1024;
+	}
+
+	Platform* platform = CreatePlatform(platformType);
+	if (platform->IsHeadless())
+	{
+		HeadlessPlatform* headless = static_cast<HeadlessPlatform*>(platform);
+		headless->SetFrameLimit(frameLimit);
+		headless->SetDumpDirectory(dumpDirectory);
+	}
+
+    Game* game = new Game("Renderer", platform);
+    game->threadCount = threadCount;
+    game->rasterKernel = rasterKernel;
+    game->textureFilter = textureFilter;
+    game->traceTileSize = traceTileSize;
+    game->loaderThreadCount = loaderThreadCount;
+    game->compressTextures = compressTextures;
+    game->textureBudget = textureBudget;
     game->Init();
 
+    // Headless frames get compared against each other, they can't depend on how fast loading went
+    if (platform->IsHeadless()) game->WaitForAssets();
+
     while (game->isRunning)
     {
         game->HandleEvents();
+        if (!game->isRunning) break;
+
         game->HandleInput();
         game->Update();
         game->Render();
     }
 
+	delete game;
+
 	return 0;
-} 
\ No newline at end of file
+}